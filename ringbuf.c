@@ -6,12 +6,600 @@
  * @file ringbuf.c Simple array backed circular queue/ring buffer implementation
  * that can hold arbitrarily sized elements.
  */
-#include <stdio.h>
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define RINGBUF_X86_KERNELS 1
+#endif
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// the library itself always provides the out-of-line functions
+#undef RINGBUF_INLINE
 #include "ringbuf.h"
 
+// Number of polls before ringbuf_*_wait parks the calling thread
+#ifndef RINGBUF_WAIT_SPINS
+#define RINGBUF_WAIT_SPINS 128
+#endif
+
+// Element tracing through ops.elem_print. Compiled out entirely (including
+// stdio) for release builds with -DNDEBUG, or explicitly with -DRINGBUF_DEBUG=0.
+#ifndef RINGBUF_DEBUG
+#ifdef NDEBUG
+#define RINGBUF_DEBUG 0
+#else
 #define RINGBUF_DEBUG 1
+#endif
+#endif
+
+#if RINGBUF_DEBUG
+#include <stdio.h>
+#endif
+
+// Number of slots that can be accessed contiguously from slot. With a
+// mirrored mapping the whole capacity is contiguous from any slot.
+static inline size_t ringbuf_contig(const struct ringbuf *rb, size_t slot)
+{
+    return (rb->flags & RINGBUF_F_MIRRORED) ? rb->capacity : rb->capacity - slot;
+}
+
+#if RINGBUF_STATS
+#define RINGBUF_STAT_ADD(rb, ctr, n) ringbuf_ctr_add(&(rb)->stat_##ctr, (n))
+#else
+#define RINGBUF_STAT_ADD(rb, ctr, n) ((void)0)
+#endif
+
+// RINGBUF_STATS: count n elements published up to index tail and track the
+// high-water mark against the producer's cached head.
+static inline void ringbuf_stat_enqueued(struct ringbuf *rb, size_t tail, size_t n)
+{
+#if RINGBUF_STATS
+    size_t count = ringbuf_idx_dist(rb, rb->head_cache, tail);
+
+    if (count > rb->capacity) {
+        count = rb->capacity;
+    }
+    ringbuf_ctr_add(&rb->stat_enqueued, n);
+    if (count > atomic_load_explicit(&rb->stat_high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&rb->stat_high_water, count, memory_order_relaxed);
+    }
+#else
+    (void)rb; (void)tail; (void)n;
+#endif
+}
+
+#if RINGBUF_TRACE
+// Tracing clock: the TSC on x86 (a few ns to read), CLOCK_MONOTONIC_RAW elsewhere
+static inline uint64_t ringbuf_trace_now(void)
+{
+#ifdef RINGBUF_X86_KERNELS
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static inline size_t ringbuf_lat_bucket(uint64_t v)
+{
+    unsigned k;
+
+    if (v < (1u << RINGBUF_LAT_SUB_BITS)) {
+        return v;
+    }
+    k = 63 - __builtin_clzll(v);
+    return ((size_t)(k - RINGBUF_LAT_SUB_BITS + 1) << RINGBUF_LAT_SUB_BITS) +
+            ((v >> (k - RINGBUF_LAT_SUB_BITS)) & ((1u << RINGBUF_LAT_SUB_BITS) - 1));
+}
+
+// Producer: stamp the sampled slots of the n elements from index idx,
+// before they are published. The clock is read at most once per call.
+static void ringbuf_trace_in(struct ringbuf *rb, size_t idx, size_t n)
+{
+    struct ringbuf_latency *lat = rb->lat;
+    size_t slot = ringbuf_idx_slot(rb, idx);
+    uint64_t now = 0;
+
+    while (n) {
+        size_t run = rb->capacity - slot < n ? rb->capacity - slot : n;
+
+        for (size_t i = (0 - slot) & lat->sample_mask; i < run; i += lat->sample_mask + 1) {
+            if (!now) {
+                now = ringbuf_trace_now();
+            }
+            lat->stamps[slot + i] = now;
+        }
+        n -= run;
+        slot = 0;
+    }
+}
+
+// Consumer: record the delay of one sampled slot stamped at stamp
+static void ringbuf_trace_sample(struct ringbuf_latency *lat, uint64_t now, uint64_t stamp)
+{
+    uint64_t d = now - stamp;
+
+    ringbuf_ctr_add(&lat->buckets[ringbuf_lat_bucket(d)], 1);
+    ringbuf_ctr_add(&lat->samples, 1);
+    if (d > atomic_load_explicit(&lat->max_ticks, memory_order_relaxed)) {
+        atomic_store_explicit(&lat->max_ticks, d, memory_order_relaxed);
+    }
+}
+
+// Consumer: record the delays of the sampled slots of the n elements from
+// index idx, before the slots are handed back to the producer.
+static void ringbuf_trace_out(struct ringbuf *rb, size_t idx, size_t n)
+{
+    struct ringbuf_latency *lat = rb->lat;
+    size_t slot = ringbuf_idx_slot(rb, idx);
+    uint64_t now = 0;
+
+    while (n) {
+        size_t run = rb->capacity - slot < n ? rb->capacity - slot : n;
+
+        for (size_t i = (0 - slot) & lat->sample_mask; i < run; i += lat->sample_mask + 1) {
+            // 0: stamped before tracing was enabled
+            if (!lat->stamps[slot + i]) {
+                continue;
+            }
+            if (!now) {
+                now = ringbuf_trace_now();
+            }
+            ringbuf_trace_sample(lat, now, lat->stamps[slot + i]);
+        }
+        n -= run;
+        slot = 0;
+    }
+}
+
+// Most stamps one RINGBUF_F_OVERWRITE remove snapshots before its CAS
+#define RINGBUF_TRACE_LOSSY_MAX 64
+
+// RINGBUF_F_OVERWRITE consumer: copy the stamps of the sampled slots of up
+// to n elements from index idx into out, together with the element copy.
+// The producer may be rewriting them, so like the elements they are only
+// valid once the claiming CAS succeeds. Stops at RINGBUF_TRACE_LOSSY_MAX
+// stamps and returns the number of elements covered, *k the stamp count.
+static size_t ringbuf_trace_peek(struct ringbuf *rb, size_t idx, size_t n, uint64_t *out,
+        size_t *k)
+{
+    struct ringbuf_latency *lat = rb->lat;
+    size_t slot = ringbuf_idx_slot(rb, idx);
+    size_t done = 0;
+
+    *k = 0;
+    while (done < n) {
+        size_t run = rb->capacity - slot < n - done ? rb->capacity - slot : n - done;
+
+        for (size_t i = (0 - slot) & lat->sample_mask; i < run; i += lat->sample_mask + 1) {
+            if (*k == RINGBUF_TRACE_LOSSY_MAX) {
+                return done + i;
+            }
+            out[(*k)++] = lat->stamps[slot + i];
+        }
+        done += run;
+        slot = 0;
+    }
+    return n;
+}
+
+// RINGBUF_F_OVERWRITE consumer: record the k stamps from ringbuf_trace_peek
+static void ringbuf_trace_record(struct ringbuf *rb, const uint64_t *stamps, size_t k)
+{
+    uint64_t now = 0;
+
+    for (size_t i = 0; i < k; i++) {
+        if (!stamps[i]) {
+            continue;
+        }
+        if (!now) {
+            now = ringbuf_trace_now();
+        }
+        ringbuf_trace_sample(rb->lat, now, stamps[i]);
+    }
+}
+
+#define RINGBUF_TRACE_IN(rb, idx, n) \
+    do { if ((rb)->lat) ringbuf_trace_in((rb), (idx), (n)); } while (0)
+#define RINGBUF_TRACE_OUT(rb, idx, n) \
+    do { if ((rb)->lat) ringbuf_trace_out((rb), (idx), (n)); } while (0)
+#else
+#define RINGBUF_TRACE_IN(rb, idx, n) ((void)0)
+#define RINGBUF_TRACE_OUT(rb, idx, n) ((void)0)
+#endif
+
+// Copy kernels, picked once per ringbuf by ringbuf_select_kernel. in copies
+// into the ringbuf storage, out copies out of it; both take a byte count.
+struct ringbuf_kernel {
+    const char *name;
+    void (*in)(void *dst, const void *src, size_t n);
+    void (*out)(void *dst, const void *src, size_t n);
+};
+
+static void ringbuf_copy_memcpy(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+// the consumer will most likely want the slot after this one next
+static void ringbuf_copy_prefetch(void *dst, const void *src, size_t n)
+{
+    __builtin_prefetch((const char *)src + n);
+    memcpy(dst, src, n);
+}
+
+#if RINGBUF_X86_KERNELS
+// Streaming copies for dst aligned to the vector size. The sfence makes the
+// weakly ordered stores visible before the tail is published.
+static void ringbuf_copy_nt_sse2(void *dst, const void *src, size_t n)
+{
+    char *d = dst;
+    const char *s = src;
+
+    for (; n >= 16; n -= 16, d += 16, s += 16) {
+        _mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+    }
+    memcpy(d, s, n);
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void ringbuf_copy_nt_avx2(void *dst, const void *src, size_t n)
+{
+    char *d = dst;
+    const char *s = src;
+
+    for (; n >= 32; n -= 32, d += 32, s += 32) {
+        _mm256_stream_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+    }
+    memcpy(d, s, n);
+    _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+static void ringbuf_copy_nt_avx512(void *dst, const void *src, size_t n)
+{
+    char *d = dst;
+    const char *s = src;
+
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+        _mm512_stream_si512((void *)d, _mm512_loadu_si512(s));
+    }
+    memcpy(d, s, n);
+    _mm_sfence();
+}
+#endif
+
+static const struct ringbuf_kernel ringbuf_kernel_memcpy = {
+    "memcpy", ringbuf_copy_memcpy, ringbuf_copy_memcpy
+};
+static const struct ringbuf_kernel ringbuf_kernel_prefetch = {
+    "prefetch", ringbuf_copy_memcpy, ringbuf_copy_prefetch
+};
+#if RINGBUF_X86_KERNELS
+static const struct ringbuf_kernel ringbuf_kernel_nt_sse2 = {
+    "nt_sse2", ringbuf_copy_nt_sse2, ringbuf_copy_prefetch
+};
+static const struct ringbuf_kernel ringbuf_kernel_nt_avx2 = {
+    "nt_avx2", ringbuf_copy_nt_avx2, ringbuf_copy_prefetch
+};
+static const struct ringbuf_kernel ringbuf_kernel_nt_avx512 = {
+    "nt_avx512", ringbuf_copy_nt_avx512, ringbuf_copy_prefetch
+};
+#endif
+
+// Small elements are left to memcpy, which already picks the best vector
+// code for the CPU. Large ones are prefetched on dequeue and, with
+// RINGBUF_F_NT, get streaming stores when every slot is aligned to the
+// vector size (the buffer and the element size both are).
+static const struct ringbuf_kernel *ringbuf_select_kernel(const void *buf, size_t elem_sz,
+        unsigned flags)
+{
+#if RINGBUF_X86_KERNELS
+    size_t align = (uintptr_t)buf | elem_sz;
+#endif
+
+    if (elem_sz < RINGBUF_NT_THRESHOLD) {
+        return &ringbuf_kernel_memcpy;
+    }
+    if (!(flags & RINGBUF_F_NT)) {
+        return &ringbuf_kernel_prefetch;
+    }
+#if RINGBUF_X86_KERNELS
+    __builtin_cpu_init();
+    if (!(align % 64) && __builtin_cpu_supports("avx512f")) {
+        return &ringbuf_kernel_nt_avx512;
+    }
+    if (!(align % 32) && __builtin_cpu_supports("avx2")) {
+        return &ringbuf_kernel_nt_avx2;
+    }
+    if (!(align % 16)) {
+        return &ringbuf_kernel_nt_sse2;
+    }
+#endif
+    return &ringbuf_kernel_prefetch;
+}
+
+// copy n contiguous elements, through ops.elem_copy_n or ops.elem_copy if
+// one is set, otherwise with the copy kernel fn (rb->kern->in or rb->kern->out)
+static void ringbuf_copy_elems(const struct ringbuf *rb, void *dst, const void *src, size_t n,
+        void (*fn)(void *dst, const void *src, size_t n))
+{
+    if (rb->ops.elem_copy_n) {
+        if (n) {
+            (*rb->ops.elem_copy_n)(dst, src, n);
+        }
+    } else if (rb->ops.elem_copy) {
+        for (size_t i = 0; i < n; i++) {
+            (*rb->ops.elem_copy)((char *)dst + i * rb->elem_sz,
+                    (const char *)src + i * rb->elem_sz);
+        }
+    } else {
+        (*fn)(dst, src, n * rb->elem_sz);
+    }
+}
+
+// copy n elements out of the ring starting at index idx, splitting at the
+// wrap point
+static void ringbuf_copy_out(const struct ringbuf *rb, void *dst, size_t idx, size_t n)
+{
+    size_t slot = ringbuf_idx_slot(rb, idx);
+    size_t run = ringbuf_contig(rb, slot) < n ? ringbuf_contig(rb, slot) : n;
+
+    ringbuf_copy_elems(rb, dst, (char *)rb->buf + rb->elem_sz * slot, run, rb->kern->out);
+    ringbuf_copy_elems(rb, (char *)dst + rb->elem_sz * run, rb->buf, n - run, rb->kern->out);
+}
+
+// zero n slots starting at index idx, splitting at the wrap point
+static void ringbuf_scrub(const struct ringbuf *rb, size_t idx, size_t n)
+{
+    size_t slot = ringbuf_idx_slot(rb, idx);
+    size_t run = ringbuf_contig(rb, slot) < n ? ringbuf_contig(rb, slot) : n;
+
+    memset((char *)rb->buf + rb->elem_sz * slot, 0, rb->elem_sz * run);
+    memset((void *)rb->buf, 0, rb->elem_sz * (n - run));
+}
+
+// Free slots as seen by the producer at tail. The cached head is only
+// refreshed from the consumer's line when it shows fewer than want free.
+static inline size_t ringbuf_prod_room(struct ringbuf *rb, size_t tail, size_t want)
+{
+    size_t room = rb->capacity - ringbuf_idx_dist(rb, rb->head_cache, tail);
+
+    if (room < want) {
+        // acquire pairs with the consumer's release of head, so slots are
+        // not overwritten before the consumer is done reading them
+        rb->head_cache = atomic_load_explicit(&rb->head, memory_order_acquire);
+        room = rb->capacity - ringbuf_idx_dist(rb, rb->head_cache, tail);
+    }
+    return room;
+}
+
+// Stored elements as seen by the consumer at head, see ringbuf_prod_room.
+static inline size_t ringbuf_cons_avail(struct ringbuf *rb, size_t head, size_t want)
+{
+    size_t avail = ringbuf_idx_dist(rb, head, rb->tail_cache);
+
+    if (avail < want) {
+        // acquire pairs with the producer's release of tail, so element
+        // contents are visible before they are read
+        rb->tail_cache = atomic_load_explicit(&rb->tail, memory_order_acquire);
+        avail = ringbuf_idx_dist(rb, head, rb->tail_cache);
+    }
+    return avail;
+}
+
+static void ringbuf_wake(atomic_uint *waiting);
+
+// Publish a new tail to the consumer, waking it if it is parked in
+// ringbuf_remove_head_wait.
+static inline void ringbuf_publish_tail(struct ringbuf *rb, size_t tail)
+{
+    atomic_store_explicit(&rb->tail, tail, memory_order_release);
+    if (rb->flags & RINGBUF_F_WAIT) {
+        // pairs with the fence in ringbuf_park: either the waiter sees the
+        // new tail or we see its flag
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&rb->cons_waiting, memory_order_relaxed)) {
+            ringbuf_wake(&rb->cons_waiting);
+        }
+    }
+}
+
+// Wake the producer if it is parked in ringbuf_add_tail_wait, after the
+// consumer has made room.
+static inline void ringbuf_notify_prod(struct ringbuf *rb)
+{
+    if (rb->flags & RINGBUF_F_WAIT) {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&rb->prod_waiting, memory_order_relaxed)) {
+            ringbuf_wake(&rb->prod_waiting);
+        }
+    }
+}
+
+// Publish a new head to the producer, see ringbuf_publish_tail.
+static inline void ringbuf_publish_head(struct ringbuf *rb, size_t head)
+{
+    atomic_store_explicit(&rb->head, head, memory_order_release);
+    ringbuf_notify_prod(rb);
+}
+
+// RINGBUF_F_OVERWRITE: make room for want elements at tail by advancing
+// head past the oldest ones. The consumer may be moving head at the same
+// time, so head is only ever advanced with a CAS in this mode.
+static size_t ringbuf_drop_oldest(struct ringbuf *rb, size_t tail, size_t want)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t room, drop;
+
+    for (;;) {
+        room = rb->capacity - (tail - head);
+        if (room >= want) {
+            break;
+        }
+        drop = want - room;
+        // acquire: a consumer that already took these slots is done with them
+        if (atomic_compare_exchange_weak_explicit(&rb->head, &head, head + drop,
+                    memory_order_acq_rel, memory_order_acquire)) {
+            ringbuf_ctr_add(&rb->dropped, drop);
+            head += drop;
+            room = want;
+            break;
+        }
+    }
+    rb->head_cache = head;
+    return room;
+}
+
+// RINGBUF_F_OVERWRITE consumer side: load a consistent head/tail pair. The
+// producer may advance head past the value we read, so reload until the
+// distance is one the ring can actually hold.
+static size_t ringbuf_lossy_avail(struct ringbuf *rb, size_t *head)
+{
+    size_t tail, avail;
+
+    *head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    for (;;) {
+        tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+        avail = tail - *head;
+        if (avail <= rb->capacity) {
+            return avail;
+        }
+        *head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    }
+}
+
+// RINGBUF_F_OVERWRITE consumer side: copy out up to n elements, then claim
+// them with a CAS on head. If the CAS fails the producer lapped us while
+// copying, the copy may be torn and is retried from the new head.
+static size_t ringbuf_remove_lossy(struct ringbuf *rb, void *elems, size_t n)
+{
+    size_t head, avail, want = n;
+#if RINGBUF_TRACE
+    uint64_t stamps[RINGBUF_TRACE_LOSSY_MAX];
+    size_t k = 0;
+#endif
+
+    for (;;) {
+        avail = ringbuf_lossy_avail(rb, &head);
+        n = want < avail ? want : avail;
+        if (!n) {
+            RINGBUF_STAT_ADD(rb, empty, 1);
+            return 0;
+        }
+#if RINGBUF_TRACE
+        // the stamps are snapshot with the elements, a lap rewrites both
+        if (rb->lat) {
+            n = ringbuf_trace_peek(rb, head, n, stamps, &k);
+        }
+#endif
+        if (elems) {
+            ringbuf_copy_out(rb, elems, head, n);
+        }
+        // release: the copy completes before the producer may reuse the slots
+        if (atomic_compare_exchange_strong_explicit(&rb->head, &head, head + n,
+                    memory_order_release, memory_order_relaxed)) {
+            break;
+        }
+        ringbuf_ctr_add(&rb->lapped, 1);
+    }
+
+#if RINGBUF_TRACE
+    if (rb->lat) {
+        ringbuf_trace_record(rb, stamps, k);
+    }
+#endif
+    RINGBUF_STAT_ADD(rb, dequeued, n);
+    ringbuf_notify_prod(rb);
+    return n;
+}
+
+// RINGBUF_F_GROW: move the contents to new storage for new_cap elements,
+// relinearized so that head starts at slot 0 again. Elements are moved with
+// plain memcpy, they are only relocated, not copied.
+static int ringbuf_resize(struct ringbuf *rb, size_t new_cap)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t count = ringbuf_idx_dist(rb, head, tail);
+    size_t slot = ringbuf_idx_slot(rb, head);
+    size_t run = ringbuf_contig(rb, slot) < count ? ringbuf_contig(rb, slot) : count;
+    char *buf;
+
+    // indices must still fit in [0, 2 * new_cap)
+    if (new_cap > SIZE_MAX / 2 / rb->elem_sz) {
+        return -1;
+    }
+    buf = (*rb->alloc->alloc)(rb->alloc->ctx, new_cap * rb->elem_sz);
+    if (!buf) {
+        return -1;
+    }
+    memcpy(buf, (const char *)rb->buf + rb->elem_sz * slot, rb->elem_sz * run);
+    memcpy(buf + rb->elem_sz * run, rb->buf, rb->elem_sz * (count - run));
+    (*rb->alloc->free)(rb->alloc->ctx, (void *)rb->buf, rb->capacity * rb->elem_sz);
+
+    rb->buf = buf;
+    rb->capacity = new_cap;
+    rb->mask = new_cap - 1;
+    rb->kern = ringbuf_select_kernel(buf, rb->elem_sz, rb->flags);
+    atomic_store_explicit(&rb->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&rb->tail, count, memory_order_relaxed);
+    rb->head_cache = 0;
+    rb->tail_cache = count;
+    rb->low_removes = 0;
+    return 0;
+}
+
+// RINGBUF_F_GROW: double the capacity until there is room for want more
+// elements. Sets tail to the (moved) tail index. Each element is moved
+// once per doubling, so adds stay amortized O(1).
+static int ringbuf_grow(struct ringbuf *rb, size_t want, size_t *tail)
+{
+    size_t count = ringbuf_count(rb);
+    size_t new_cap = rb->capacity;
+
+    while (new_cap - count < want) {
+        if (new_cap > SIZE_MAX / 2) {
+            return -1;
+        }
+        new_cap *= 2;
+    }
+    if (ringbuf_resize(rb, new_cap) < 0) {
+        return -1;
+    }
+    *tail = count;
+    return 0;
+}
+
+// RINGBUF_F_SHRINK: called after each removal. Halving at under a quarter
+// full leaves the ringbuf at most half full, so it does not flap between
+// sizes.
+static void ringbuf_maybe_shrink(struct ringbuf *rb)
+{
+    if (rb->capacity / 2 < rb->min_capacity || ringbuf_count(rb) >= rb->capacity / 4) {
+        rb->low_removes = 0;
+        return;
+    }
+    if (++rb->low_removes >= rb->capacity) {
+        if (ringbuf_resize(rb, rb->capacity / 2) < 0) {
+            rb->low_removes = 0;
+        }
+    }
+}
 
 /**
  * Initialize a ringbuf struct.
@@ -24,28 +612,442 @@
  * 
  * These semantics are similar to qsort() and bsearch().
  *
+ * If n_elem is a power of two, RINGBUF_F_POW2 is set automatically.
+ *
  * @param rb pointer to the ringbuf struct to initialize
  * @param buf pointer to the array buffer
  * @param n_elem maximum number of elements buf can hold
  * @param elem_sz the size (bytes) of each element
  * @return 0 on success, -1 if rb or buf are NULL
  */
-int ringbuf_init(struct ringbuf *rb, const void *buf, size_t n_elem, size_t elem_sz)
+int ringbuf_init(struct ringbuf *rb, const void *buf, size_t n_elem, size_t elem_sz)
+{
+    unsigned flags = 0;
+
+    if (n_elem && !(n_elem & (n_elem - 1))) {
+        flags |= RINGBUF_F_POW2;
+    }
+    return ringbuf_init_flags(rb, buf, n_elem, elem_sz, flags);
+}
+
+/**
+ * Initialize a ringbuf struct with explicit RINGBUF_F_* flags.
+ *
+ * Same as ringbuf_init, except capacity properties are not detected
+ * automatically.
+ *
+ * @param flags RINGBUF_F_* flags
+ * @return 0 on success, -1 if rb or buf are NULL, if RINGBUF_F_POW2 or
+ * RINGBUF_F_OVERWRITE is requested and n_elem is not a power of two, or if
+ * RINGBUF_F_OVERWRITE is combined with RINGBUF_F_SCRUB. RINGBUF_F_GROW and
+ * RINGBUF_F_SHRINK are only accepted by ringbuf_init_growable, and
+ * RINGBUF_F_MIRRORED is only set by ringbuf_init_mirrored.
+ */
+int ringbuf_init_flags(struct ringbuf *rb, const void *buf, size_t n_elem, size_t elem_sz,
+        unsigned flags)
+{
+    if (!rb || !buf) {
+        return -1;
+    }
+    if ((flags & (RINGBUF_F_POW2 | RINGBUF_F_OVERWRITE)) && (!n_elem || (n_elem & (n_elem - 1)))) {
+        return -1;
+    }
+    if ((flags & RINGBUF_F_OVERWRITE) && (flags & RINGBUF_F_SCRUB)) {
+        return -1;
+    }
+    if (flags & (RINGBUF_F_GROW | RINGBUF_F_SHRINK | RINGBUF_F_MIRRORED)) {
+        return -1;
+    }
+    if (flags & RINGBUF_F_OVERWRITE) {
+        flags |= RINGBUF_F_POW2;
+    }
+
+    rb->buf = buf;
+    rb->capacity = n_elem;
+    rb->elem_sz = elem_sz;
+    rb->mask = n_elem - 1;
+    rb->flags = flags;
+    rb->kern = ringbuf_select_kernel(buf, elem_sz, flags);
+    rb->alloc = NULL;
+    rb->min_capacity = n_elem;
+    rb->low_removes = 0;
+    rb->lat = NULL;
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    rb->head_cache = 0;
+    rb->tail_cache = 0;
+    atomic_init(&rb->dropped, 0);
+    atomic_init(&rb->lapped, 0);
+    atomic_init(&rb->stat_enqueued, 0);
+    atomic_init(&rb->stat_full, 0);
+    atomic_init(&rb->stat_high_water, 0);
+    atomic_init(&rb->stat_prod_waits, 0);
+    atomic_init(&rb->stat_dequeued, 0);
+    atomic_init(&rb->stat_empty, 0);
+    atomic_init(&rb->stat_cons_waits, 0);
+    atomic_init(&rb->cons_waiting, 0);
+    atomic_init(&rb->prod_waiting, 0);
+    rb->ops.elem_copy = NULL;
+    rb->ops.elem_copy_n = NULL;
+    rb->ops.elem_print = NULL;
+
+    return 0;
+}
+
+/**
+ * Initialize a ringbuf with newly allocated, double-mapped backing storage.
+ *
+ * The same physical pages are mapped twice back to back, so any run of up
+ * to capacity elements starting at any slot is contiguous in virtual
+ * memory. Spans from ringbuf_reserve_tail_span/ringbuf_peek_head_span then
+ * never stop at the wrap point, and bulk copies are never split.
+ *
+ * The storage size must be a multiple of the page size, so n_elem is
+ * rounded up as needed; check rb->capacity for the actual capacity.
+ * Release the storage with ringbuf_free_mirrored. Linux only.
+ *
+ * @param rb pointer to the ringbuf struct to initialize
+ * @param n_elem minimum number of elements to hold
+ * @param elem_sz the size (bytes) of each element
+ * @param flags RINGBUF_F_* flags, RINGBUF_F_POW2 is detected automatically
+ * @return 0 on success, -1 on failure
+ */
+int ringbuf_init_mirrored(struct ringbuf *rb, size_t n_elem, size_t elem_sz, unsigned flags)
+{
+#ifdef __linux__
+    size_t page, low, step, sz;
+    char *addr;
+    int fd;
+
+    if (!rb || !n_elem || !elem_sz) {
+        return -1;
+    }
+
+    // round n_elem up to a multiple of page / gcd(page, elem_sz) so the
+    // storage fills whole pages. page is a power of two, so the gcd is the
+    // lowest set bit of elem_sz, capped at page.
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    low = elem_sz & -elem_sz;
+    step = page / (low < page ? low : page);
+    if (n_elem > SIZE_MAX - (step - 1)) {
+        return -1;
+    }
+    n_elem = (n_elem + step - 1) / step * step;
+    // both halves of the mapping must fit in a size_t
+    if (n_elem > SIZE_MAX / 2 / elem_sz) {
+        return -1;
+    }
+    sz = n_elem * elem_sz;
+    if (!(n_elem & (n_elem - 1))) {
+        flags |= RINGBUF_F_POW2;
+    }
+
+    fd = memfd_create("ringbuf", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, sz) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    // reserve 2 * sz of address space, then map the file into both halves
+    addr = mmap(NULL, 2 * sz, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (mmap(addr, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(addr + sz, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(addr, 2 * sz);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    if (ringbuf_init_flags(rb, addr, n_elem, elem_sz, flags & ~RINGBUF_F_MIRRORED) < 0) {
+        munmap(addr, 2 * sz);
+        return -1;
+    }
+    rb->flags |= RINGBUF_F_MIRRORED;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Releases storage allocated by ringbuf_init_mirrored.
+ */
+void ringbuf_free_mirrored(struct ringbuf *rb)
+{
+#ifdef __linux__
+    if (rb && rb->buf && (rb->flags & RINGBUF_F_MIRRORED)) {
+        munmap((void *)rb->buf, 2 * rb->capacity * rb->elem_sz);
+        rb->buf = NULL;
+    }
+#endif
+}
+
+static void *ringbuf_default_alloc(void *ctx, size_t sz)
+{
+    (void)ctx;
+    return malloc(sz);
+}
+
+static void ringbuf_default_free(void *ctx, void *p, size_t sz)
+{
+    (void)ctx; (void)sz;
+    free(p);
+}
+
+static const struct ringbuf_allocator ringbuf_default_allocator = {
+    ringbuf_default_alloc, ringbuf_default_free, NULL
+};
+
+/**
+ * Initialize a ringbuf with allocated storage that grows when full.
+ *
+ * Adding to a full ringbuf doubles its capacity and relinearizes the
+ * contents in one pass, so adds are amortized O(1) and only fail when the
+ * allocator does. With RINGBUF_F_SHRINK the capacity is halved again after
+ * sustained low occupancy. Not for concurrent use, see RINGBUF_F_GROW.
+ * Release the storage with ringbuf_free_growable.
+ *
+ * @param rb pointer to the ringbuf struct to initialize
+ * @param n_elem initial (and minimum) capacity
+ * @param elem_sz the size (bytes) of each element
+ * @param flags RINGBUF_F_* flags, RINGBUF_F_POW2 is detected automatically.
+ * Cannot include RINGBUF_F_WAIT, RINGBUF_F_MIRRORED or RINGBUF_F_OVERWRITE.
+ * @param alloc allocator callbacks, NULL for malloc/free. Must outlive rb.
+ * @return 0 on success, -1 on failure
+ */
+int ringbuf_init_growable(struct ringbuf *rb, size_t n_elem, size_t elem_sz, unsigned flags,
+        const struct ringbuf_allocator *alloc)
+{
+    void *buf;
+
+    if (!rb || !n_elem || !elem_sz || n_elem > SIZE_MAX / 2 / elem_sz) {
+        return -1;
+    }
+    if (flags & (RINGBUF_F_WAIT | RINGBUF_F_MIRRORED | RINGBUF_F_OVERWRITE)) {
+        return -1;
+    }
+    if (!alloc) {
+        alloc = &ringbuf_default_allocator;
+    }
+    if (!(n_elem & (n_elem - 1))) {
+        flags |= RINGBUF_F_POW2;
+    }
+
+    buf = (*alloc->alloc)(alloc->ctx, n_elem * elem_sz);
+    if (!buf) {
+        return -1;
+    }
+    if (ringbuf_init_flags(rb, buf, n_elem, elem_sz,
+                flags & ~(RINGBUF_F_GROW | RINGBUF_F_SHRINK)) < 0) {
+        (*alloc->free)(alloc->ctx, buf, n_elem * elem_sz);
+        return -1;
+    }
+    rb->flags |= RINGBUF_F_GROW | (flags & RINGBUF_F_SHRINK);
+    rb->alloc = alloc;
+    return 0;
+}
+
+/**
+ * Releases storage allocated by ringbuf_init_growable.
+ */
+void ringbuf_free_growable(struct ringbuf *rb)
+{
+    if (rb && rb->buf && (rb->flags & RINGBUF_F_GROW)) {
+        (*rb->alloc->free)(rb->alloc->ctx, (void *)rb->buf, rb->capacity * rb->elem_sz);
+        rb->buf = NULL;
+    }
+}
+
+/**
+ * Returns the number of elements currently stored.
+ *
+ * When called concurrently with the producer or consumer the result is a
+ * snapshot that may already be stale by the time it is returned.
+ */
+size_t ringbuf_count(const struct ringbuf *rb)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t count = ringbuf_idx_dist(rb, head, tail);
+
+    // with RINGBUF_F_OVERWRITE the producer may move head after we read it
+    return count > rb->capacity ? rb->capacity : count;
+}
+
+/**
+ * Returns the number of elements dropped by RINGBUF_F_OVERWRITE so far.
+ */
+size_t ringbuf_dropped(const struct ringbuf *rb)
+{
+    return atomic_load_explicit(&rb->dropped, memory_order_relaxed);
+}
+
+/**
+ * Returns the name of the copy kernel picked for this ringbuf at init time
+ * ("memcpy", "prefetch", "nt_sse2", "nt_avx2" or "nt_avx512"). Not used
+ * while ops.elem_copy or ops.elem_copy_n is set.
+ */
+const char *ringbuf_copy_kernel(const struct ringbuf *rb)
+{
+    return rb->kern->name;
+}
+
+/**
+ * Takes a snapshot of the ringbuf counters.
+ *
+ * Only reads, with relaxed loads, so it can be polled from any thread (e.g.
+ * a metrics exporter) while the producer and consumer keep running. The
+ * counters are read one at a time, so they need not be mutually consistent.
+ * @param st filled in with the current counters
+ */
+void ringbuf_stats_snapshot(const struct ringbuf *rb, struct ringbuf_stats *st)
+{
+    st->enqueued = atomic_load_explicit(&rb->stat_enqueued, memory_order_relaxed);
+    st->dequeued = atomic_load_explicit(&rb->stat_dequeued, memory_order_relaxed);
+    st->full = atomic_load_explicit(&rb->stat_full, memory_order_relaxed);
+    st->empty = atomic_load_explicit(&rb->stat_empty, memory_order_relaxed);
+    st->high_water = atomic_load_explicit(&rb->stat_high_water, memory_order_relaxed);
+    st->dropped = atomic_load_explicit(&rb->dropped, memory_order_relaxed);
+    st->lapped = atomic_load_explicit(&rb->lapped, memory_order_relaxed);
+    st->prod_waits = atomic_load_explicit(&rb->stat_prod_waits, memory_order_relaxed);
+    st->cons_waits = atomic_load_explicit(&rb->stat_cons_waits, memory_order_relaxed);
+    st->count = ringbuf_count(rb);
+    st->lat_samples = 0;
+    st->lat_p50_ns = st->lat_p99_ns = st->lat_max_ns = 0;
+    if (rb->lat) {
+        st->lat_samples = atomic_load_explicit(&rb->lat->samples, memory_order_relaxed);
+        st->lat_p50_ns = ringbuf_latency_percentile_ns(rb->lat, 50);
+        st->lat_p99_ns = ringbuf_latency_percentile_ns(rb->lat, 99);
+        st->lat_max_ns = atomic_load_explicit(&rb->lat->max_ticks, memory_order_relaxed) *
+                rb->lat->ns_per_tick;
+    }
+}
+
+#if RINGBUF_TRACE
+// ns per tick of ringbuf_trace_now, measured once against CLOCK_MONOTONIC_RAW
+static double ringbuf_trace_ns_per_tick(void)
+{
+#ifdef RINGBUF_X86_KERNELS
+    static double ns_per_tick;
+    struct timespec t0, t1;
+    uint64_t c0, c1;
+    long long ns;
+
+    if (ns_per_tick == 0) {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &t0);
+        c0 = __rdtsc();
+        do {
+            clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+            ns = (t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec);
+        } while (ns < 2000000);
+        c1 = __rdtsc();
+        ns_per_tick = (double)ns / (c1 - c0);
+    }
+    return ns_per_tick;
+#else
+    return 1.0;
+#endif
+}
+#endif
+
+/**
+ * Starts timing how long elements wait in the ringbuf (RINGBUF_TRACE builds).
+ *
+ * Every 2^sample_shift-th slot is timed: the producer stamps it when it is
+ * published and the consumer adds the delay to lat when it is removed or
+ * released. A call that touches no sampled slot does not read the clock,
+ * and every call reads it at most once. Call while neither side is running;
+ * the histogram in lat is cleared. Not supported with RINGBUF_F_GROW, whose
+ * resizing moves the slots.
+ * @param lat histogram, owned by the caller until ringbuf_latency_disable
+ * @param stamps array of capacity timestamps
+ * @param sample_shift log2 of the sampling period, 0 times every element
+ * @return 0 on success, -1 on invalid arguments or without RINGBUF_TRACE
+ */
+int ringbuf_latency_enable(struct ringbuf *rb, struct ringbuf_latency *lat, uint64_t *stamps,
+        unsigned sample_shift)
+{
+#if RINGBUF_TRACE
+    if (!lat || !stamps || (rb->flags & RINGBUF_F_GROW) || sample_shift >= 8 * sizeof(size_t)) {
+        return -1;
+    }
+    memset(stamps, 0, rb->capacity * sizeof(*stamps));
+    lat->stamps = stamps;
+    lat->sample_mask = ((size_t)1 << sample_shift) - 1;
+    lat->ns_per_tick = ringbuf_trace_ns_per_tick();
+    atomic_init(&lat->samples, 0);
+    atomic_init(&lat->max_ticks, 0);
+    for (size_t i = 0; i < RINGBUF_LAT_BUCKETS; i++) {
+        atomic_init(&lat->buckets[i], 0);
+    }
+    rb->lat = lat;
+    return 0;
+#else
+    (void)rb; (void)lat; (void)stamps; (void)sample_shift;
+    return -1;
+#endif
+}
+
+/**
+ * Stops timing elements. The histogram stays readable.
+ */
+void ringbuf_latency_disable(struct ringbuf *rb)
+{
+    rb->lat = NULL;
+}
+
+/**
+ * Returns the smallest delay (ns) counted in histogram bucket.
+ */
+uint64_t ringbuf_latency_bucket_ns(const struct ringbuf_latency *lat, size_t bucket)
 {
-    if (!rb || !buf) {
-        return -1;
+    const size_t sub = (size_t)1 << RINGBUF_LAT_SUB_BITS;
+    uint64_t ticks;
+
+    if (bucket < sub) {
+        ticks = bucket;
+    } else {
+        ticks = (uint64_t)(sub + (bucket & (sub - 1))) <<
+                ((bucket >> RINGBUF_LAT_SUB_BITS) - 1);
     }
+    return ticks * lat->ns_per_tick;
+}
 
-    rb->buf = buf;
-    rb->capacity = n_elem;
-    rb->elem_sz = elem_sz;
-    rb->head = 0;
-    rb->tail = 0;
-    rb->count = 0;
-    rb->ops.elem_copy = NULL;
-    rb->ops.elem_print = NULL;
+/**
+ * Returns the delay (ns) that pct percent of the recorded delays do not
+ * exceed, up to the bucket resolution (the bucket's upper bound is
+ * reported). 0 if nothing was recorded.
+ * @param pct percentile, 0 to 100
+ */
+uint64_t ringbuf_latency_percentile_ns(const struct ringbuf_latency *lat, double pct)
+{
+    size_t samples = atomic_load_explicit(&lat->samples, memory_order_relaxed);
+    size_t want = (size_t)(samples * pct / 100.0 + 0.5), seen = 0;
+    uint64_t max_ns = atomic_load_explicit(&lat->max_ticks, memory_order_relaxed) *
+            lat->ns_per_tick;
 
-    return 0;
+    if (!samples) {
+        return 0;
+    }
+    if (!want) {
+        want = 1;
+    }
+    for (size_t i = 0; i < RINGBUF_LAT_BUCKETS - 1; i++) {
+        seen += atomic_load_explicit(&lat->buckets[i], memory_order_relaxed);
+        if (seen >= want) {
+            uint64_t hi = ringbuf_latency_bucket_ns(lat, i + 1);
+
+            return hi < max_ns ? hi : max_ns;
+        }
+    }
+    return max_ns;
 }
 
 /**
@@ -54,7 +1056,7 @@ int ringbuf_init(struct ringbuf *rb, const void *buf, size_t n_elem, size_t elem
  */
 int ringbuf_full(const struct ringbuf *rb)
 {
-    return rb->count == rb->capacity;
+    return ringbuf_count(rb) == rb->capacity;
 }
 
 /**
@@ -63,50 +1065,116 @@ int ringbuf_full(const struct ringbuf *rb)
  */
 int ringbuf_empty(const struct ringbuf *rb)
 {
-    return 0 == rb->count;
+    return 0 == ringbuf_count(rb);
+}
+
+/**
+ * Returns the elements at positions [start, start + n) from the head as up
+ * to two contiguous spans, one on each side of the wrap point.
+ *
+ * Lets callers scan (or run vectorized reductions over) the contents in
+ * place, without a modulo or bounds check per element. The range is
+ * clipped to the elements currently stored. Consumer side, or any thread
+ * while the consumer is idle; the producer may keep adding, which does not
+ * affect elements already stored. With RINGBUF_F_OVERWRITE the producer
+ * may overwrite them while they are being read.
+ * @param start position of the first element, 0 is the head
+ * @param n number of elements wanted
+ * @param spans set to the spans, spans[1].n is 0 if the range does not wrap
+ * @return number of elements covered (spans[0].n + spans[1].n)
+ */
+size_t ringbuf_range(const struct ringbuf *rb, size_t start, size_t n,
+        struct ringbuf_span spans[2])
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t count = ringbuf_count(rb);
+    size_t slot, run;
+
+    if (start > count) {
+        start = count;
+    }
+    if (n > count - start) {
+        n = count - start;
+    }
+    slot = ringbuf_idx_slot(rb, ringbuf_idx_add(rb, head, start));
+    run = ringbuf_contig(rb, slot) < n ? ringbuf_contig(rb, slot) : n;
+
+    spans[0].ptr = (char *)rb->buf + rb->elem_sz * slot;
+    spans[0].n = run;
+    spans[1].ptr = (void *)rb->buf;
+    spans[1].n = n - run;
+    return n;
+}
+
+/**
+ * Returns the element at position i from the head for in-place access.
+ * Same rules as ringbuf_range.
+ * @param i position, 0 is the head (oldest) element
+ * @return pointer to the element, NULL if fewer than i + 1 are stored
+ */
+void *ringbuf_at(const struct ringbuf *rb, size_t i)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+
+    if (i >= ringbuf_count(rb)) {
+        return NULL;
+    }
+    return (char *)rb->buf + rb->elem_sz * ringbuf_idx_slot(rb, ringbuf_idx_add(rb, head, i));
 }
 
 #if RINGBUF_DEBUG
 // print elems in order from head to tail
 static void ringbuf_print_elems(const struct ringbuf *rb, void (*fn)(const void *))
 {
-    void *p;
+    struct ringbuf_span spans[2];
+    size_t count = ringbuf_range(rb, 0, rb->capacity, spans);
 
-    for (size_t i = 0; i < rb->count; i++) {
-        p = (char *)rb->buf + (rb->elem_sz * ((rb->head + i) % rb->capacity));
-        (*fn)(p);
-        printf(" ");
+    for (int s = 0; s < 2; s++) {
+        for (size_t i = 0; i < spans[s].n; i++) {
+            (*fn)((char *)spans[s].ptr + rb->elem_sz * i);
+            printf(" ");
+        }
     }
-    printf("%s\n", rb->count == 0 ? "(empty)" : "");
+    printf("%s\n", count == 0 ? "(empty)" : "");
 }
 #endif
 
 /**
  * Adds an element to the tail of the ringbuf.
+ *
+ * Producer side: may run concurrently with ringbuf_remove_head on another thread.
+ * With RINGBUF_F_OVERWRITE a full ringbuf drops its oldest element instead
+ * of failing, with RINGBUF_F_GROW it grows.
  * @param elem element to add. If NULL, the ringbuf is not modified and 0 is returned.
  * @return 0 on success, -1 if ringbuf is full
  */
 int ringbuf_add_tail(struct ringbuf *rb, const void *elem)
 {
+    size_t tail;
     void *tp;
 
     if (!elem) {
         return 0;
     }
-    if (ringbuf_full(rb)) {
-        return -1;
+
+    tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    if (!ringbuf_prod_room(rb, tail, 1)) {
+        if (rb->flags & RINGBUF_F_OVERWRITE) {
+            ringbuf_drop_oldest(rb, tail, 1);
+        } else if (!(rb->flags & RINGBUF_F_GROW) || ringbuf_grow(rb, 1, &tail) < 0) {
+            RINGBUF_STAT_ADD(rb, full, 1);
+            return -1;
+        }
     }
 
-    tp = (char*)rb->buf + (rb->elem_sz * rb->tail);
+    tp = (char*)rb->buf + (rb->elem_sz * ringbuf_idx_slot(rb, tail));
 
-    if (rb->ops.elem_copy) {
-        (*rb->ops.elem_copy)(tp, elem);
-    } else {
-        memcpy(tp, elem, rb->elem_sz);
-    }
+    ringbuf_copy_elems(rb, tp, elem, 1, rb->kern->in);
 
-    rb->tail = (rb->tail + 1) % rb->capacity;
-    rb->count += 1;
+    // publish the element to the consumer
+    RINGBUF_TRACE_IN(rb, tail, 1);
+    ringbuf_publish_tail(rb, ringbuf_idx_add(rb, tail, 1));
+    ringbuf_stat_enqueued(rb, ringbuf_idx_add(rb, tail, 1), 1);
 
 #if RINGBUF_DEBUG
     // XXX: Demo only, rip it out if code used for anything real
@@ -123,25 +1191,34 @@ int ringbuf_add_tail(struct ringbuf *rb, const void *elem)
 
 /**
  * Removes an element from the head of the ringbuf.
+ *
+ * Consumer side: may run concurrently with ringbuf_add_tail on another thread.
+ * With RINGBUF_F_OVERWRITE, if the producer laps the consumer while the
+ * element is being copied, the copy is discarded and the next oldest
+ * element is returned instead. Note ops.elem_copy may see a torn element
+ * in that case.
  * @param elem where to copy the removed element. If NULL, the element is simply removed.
  * @return 0 on success, -1 if ringbuf is empty
  */
 int ringbuf_remove_head(struct ringbuf *rb, void *elem)
 {
+    size_t head;
     void *hp;
 
-    if (ringbuf_empty(rb)) {
+    if (rb->flags & RINGBUF_F_OVERWRITE) {
+        return ringbuf_remove_lossy(rb, elem, 1) ? 0 : -1;
+    }
+
+    head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    if (!ringbuf_cons_avail(rb, head, 1)) {
+        RINGBUF_STAT_ADD(rb, empty, 1);
         return -1;
     }
 
-    hp = (char *)rb->buf + (rb->elem_sz * rb->head);
+    hp = (char *)rb->buf + (rb->elem_sz * ringbuf_idx_slot(rb, head));
 
     if (elem) {
-        if (rb->ops.elem_copy) {
-            (*rb->ops.elem_copy)(elem, hp);
-        } else {
-            memcpy(elem, hp, rb->elem_sz);
-        }
+        ringbuf_copy_elems(rb, elem, hp, 1, rb->kern->out);
 #if RINGBUF_DEBUG
         // XXX:
         if (rb->ops.elem_print) {
@@ -151,12 +1228,19 @@ int ringbuf_remove_head(struct ringbuf *rb, void *elem)
         }
 #endif
     }
-    // Not actually necessary, but can zero out the element just removed
-    // from the buffer.
-    memset(hp, 0, rb->elem_sz);
+    // Not necessary for correctness, only done on request for queues
+    // carrying sensitive data.
+    if (rb->flags & RINGBUF_F_SCRUB) {
+        memset(hp, 0, rb->elem_sz);
+    }
 
-    rb->head = (rb->head + 1) % rb->capacity;
-    rb->count -= 1;
+    // hand the slot back to the producer
+    RINGBUF_TRACE_OUT(rb, head, 1);
+    ringbuf_publish_head(rb, ringbuf_idx_add(rb, head, 1));
+    RINGBUF_STAT_ADD(rb, dequeued, 1);
+    if (rb->flags & RINGBUF_F_SHRINK) {
+        ringbuf_maybe_shrink(rb);
+    }
 
 #if RINGBUF_DEBUG
     // XXX: Demo only, rip it out if code used for anything real
@@ -167,3 +1251,508 @@ int ringbuf_remove_head(struct ringbuf *rb, void *elem)
 
     return 0;
 }
+
+/**
+ * Adds up to n elements to the tail of the ringbuf.
+ *
+ * Elements are copied in at most two runs, one on each side of the wrap
+ * point. Producer side, same concurrency rules as ringbuf_add_tail.
+ * With RINGBUF_F_OVERWRITE all n elements are always added, dropping the
+ * oldest ones as needed (including the first ones of elems if n > capacity).
+ * With RINGBUF_F_GROW the ringbuf grows to fit all n.
+ * @param elems array of n elements to add
+ * @param n number of elements in elems
+ * @return number of elements added, less than n if the ringbuf filled up.
+ * 0 if elems is NULL.
+ */
+size_t ringbuf_add_tail_n(struct ringbuf *rb, const void *elems, size_t n)
+{
+    size_t tail, room, slot, run, added = n;
+
+    if (!elems) {
+        return 0;
+    }
+
+    tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    if ((rb->flags & RINGBUF_F_OVERWRITE) && n > rb->capacity) {
+        // only the last capacity elements would survive anyway
+        elems = (const char *)elems + rb->elem_sz * (n - rb->capacity);
+        ringbuf_ctr_add(&rb->dropped, n - rb->capacity);
+        n = rb->capacity;
+    }
+    room = ringbuf_prod_room(rb, tail, n);
+    if (n > room && (rb->flags & RINGBUF_F_OVERWRITE)) {
+        room = ringbuf_drop_oldest(rb, tail, n);
+    }
+    if (n > room && (rb->flags & RINGBUF_F_GROW) && ringbuf_grow(rb, n, &tail) == 0) {
+        room = n;
+    }
+    if (n > room) {
+        RINGBUF_STAT_ADD(rb, full, 1);
+        added = n = room;
+    }
+    if (!n) {
+        return 0;
+    }
+
+    slot = ringbuf_idx_slot(rb, tail);
+    run = ringbuf_contig(rb, slot) < n ? ringbuf_contig(rb, slot) : n;
+    ringbuf_copy_elems(rb, (char *)rb->buf + rb->elem_sz * slot, elems, run, rb->kern->in);
+    ringbuf_copy_elems(rb, (void *)rb->buf, (const char *)elems + rb->elem_sz * run, n - run,
+            rb->kern->in);
+
+    RINGBUF_TRACE_IN(rb, tail, n);
+    ringbuf_publish_tail(rb, ringbuf_idx_add(rb, tail, n));
+    ringbuf_stat_enqueued(rb, ringbuf_idx_add(rb, tail, n), added);
+
+#if RINGBUF_DEBUG
+    if (rb->ops.elem_print) {
+        printf("%s: added %zu elems\n", __FUNCTION__, n);
+        ringbuf_print_elems(rb, rb->ops.elem_print);
+    }
+#endif
+
+    return added;
+}
+
+/**
+ * Removes up to n elements from the head of the ringbuf.
+ *
+ * Elements are copied out in at most two runs, one on each side of the wrap
+ * point. Consumer side, same concurrency rules as ringbuf_remove_head,
+ * including the RINGBUF_F_OVERWRITE retry.
+ * @param elems where to copy the removed elements, must have room for n.
+ * If NULL, the elements are simply removed.
+ * @param n maximum number of elements to remove
+ * @return number of elements removed, less than n if the ringbuf ran empty.
+ * With latency tracing on a RINGBUF_F_OVERWRITE ringbuf, one call also
+ * stops after 64 sampled slots.
+ */
+size_t ringbuf_remove_head_n(struct ringbuf *rb, void *elems, size_t n)
+{
+    size_t head, avail, slot, run;
+    char *hp;
+
+    if (rb->flags & RINGBUF_F_OVERWRITE) {
+        return ringbuf_remove_lossy(rb, elems, n);
+    }
+
+    head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    avail = ringbuf_cons_avail(rb, head, n);
+    if (n > avail) {
+        n = avail;
+    }
+    if (!n) {
+        RINGBUF_STAT_ADD(rb, empty, 1);
+        return 0;
+    }
+
+    slot = ringbuf_idx_slot(rb, head);
+    run = ringbuf_contig(rb, slot) < n ? ringbuf_contig(rb, slot) : n;
+    hp = (char *)rb->buf + rb->elem_sz * slot;
+    if (elems) {
+        ringbuf_copy_elems(rb, elems, hp, run, rb->kern->out);
+        ringbuf_copy_elems(rb, (char *)elems + rb->elem_sz * run, rb->buf, n - run,
+                rb->kern->out);
+    }
+    if (rb->flags & RINGBUF_F_SCRUB) {
+        ringbuf_scrub(rb, head, n);
+    }
+
+    RINGBUF_TRACE_OUT(rb, head, n);
+    ringbuf_publish_head(rb, ringbuf_idx_add(rb, head, n));
+    RINGBUF_STAT_ADD(rb, dequeued, n);
+    if (rb->flags & RINGBUF_F_SHRINK) {
+        ringbuf_maybe_shrink(rb);
+    }
+
+#if RINGBUF_DEBUG
+    if (rb->ops.elem_print) {
+        printf("%s: removed %zu elems\n", __FUNCTION__, n);
+        ringbuf_print_elems(rb, rb->ops.elem_print);
+    }
+#endif
+
+    return n;
+}
+
+/**
+ * Reserves a contiguous run of free slots at the tail for in-place writing.
+ *
+ * The returned slots are not visible to the consumer until they are
+ * published with ringbuf_commit_tail_n. Producer side. With
+ * RINGBUF_F_OVERWRITE a full ringbuf drops its oldest element to free a slot,
+ * with RINGBUF_F_GROW it grows.
+ * @param n set to the number of contiguous free slots available before the
+ * wrap point (0 if the ringbuf is full)
+ * @return pointer to the first free slot, NULL if the ringbuf is full
+ */
+void *ringbuf_reserve_tail_span(struct ringbuf *rb, size_t *n)
+{
+    size_t tail, slot, avail;
+
+    tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    slot = ringbuf_idx_slot(rb, tail);
+    avail = ringbuf_prod_room(rb, tail, ringbuf_contig(rb, slot));
+    if (!avail && (rb->flags & RINGBUF_F_OVERWRITE)) {
+        avail = ringbuf_drop_oldest(rb, tail, 1);
+    }
+    if (!avail && (rb->flags & RINGBUF_F_GROW) && ringbuf_grow(rb, 1, &tail) == 0) {
+        slot = ringbuf_idx_slot(rb, tail);
+        avail = ringbuf_prod_room(rb, tail, ringbuf_contig(rb, slot));
+    }
+    if (avail > ringbuf_contig(rb, slot)) {
+        avail = ringbuf_contig(rb, slot);
+    }
+    if (!avail) {
+        RINGBUF_STAT_ADD(rb, full, 1);
+    }
+
+    *n = avail;
+    return avail ? (char *)rb->buf + rb->elem_sz * slot : NULL;
+}
+
+/**
+ * Reserves the next free tail slot for in-place writing.
+ * @see ringbuf_reserve_tail_span
+ * @return pointer to the slot, NULL if the ringbuf is full
+ */
+void *ringbuf_reserve_tail(struct ringbuf *rb)
+{
+    size_t n;
+
+    return ringbuf_reserve_tail_span(rb, &n);
+}
+
+/**
+ * Returns all free slots at the tail as up to two contiguous spans, the
+ * second one starting at the beginning of the storage after the wrap point.
+ *
+ * Useful to hand the free space to a scatter/gather call (readv, an
+ * io_uring readv, a DMA descriptor list) in one go. Publish what was
+ * written with ringbuf_commit_tail_n, spans[0] first. Producer side.
+ * @param spans set to the free spans, spans[1].n is 0 if there is no wrap
+ * @return total number of free slots (spans[0].n + spans[1].n)
+ */
+size_t ringbuf_tail_spans(struct ringbuf *rb, struct ringbuf_span spans[2])
+{
+    size_t tail, slot, room, run;
+
+    tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    slot = ringbuf_idx_slot(rb, tail);
+    room = ringbuf_prod_room(rb, tail, rb->capacity);
+    run = ringbuf_contig(rb, slot) < room ? ringbuf_contig(rb, slot) : room;
+
+    spans[0].ptr = (char *)rb->buf + rb->elem_sz * slot;
+    spans[0].n = run;
+    spans[1].ptr = (void *)rb->buf;
+    spans[1].n = room - run;
+    return room;
+}
+
+/**
+ * Publishes n reserved tail slots to the consumer.
+ * @param n number of slots written in place since the last commit
+ * @return 0 on success, -1 if fewer than n slots are free
+ */
+int ringbuf_commit_tail_n(struct ringbuf *rb, size_t n)
+{
+    size_t tail;
+
+    tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    if (n > ringbuf_prod_room(rb, tail, n)) {
+        if (!(rb->flags & RINGBUF_F_OVERWRITE) || n > rb->capacity) {
+            RINGBUF_STAT_ADD(rb, full, 1);
+            return -1;
+        }
+        ringbuf_drop_oldest(rb, tail, n);
+    }
+
+    RINGBUF_TRACE_IN(rb, tail, n);
+    ringbuf_publish_tail(rb, ringbuf_idx_add(rb, tail, n));
+    ringbuf_stat_enqueued(rb, ringbuf_idx_add(rb, tail, n), n);
+    return 0;
+}
+
+/**
+ * Publishes the slot returned by ringbuf_reserve_tail.
+ * @return 0 on success, -1 if the ringbuf is full
+ */
+int ringbuf_commit_tail(struct ringbuf *rb)
+{
+    return ringbuf_commit_tail_n(rb, 1);
+}
+
+/**
+ * Returns a contiguous run of stored elements at the head for in-place reading.
+ *
+ * The elements stay in the ringbuf until they are released with
+ * ringbuf_release_head_n. Consumer side. With RINGBUF_F_OVERWRITE the
+ * producer may overwrite the span while it is being read; that is reported
+ * by ringbuf_release_head_n failing.
+ * @param n set to the number of contiguous elements available before the
+ * wrap point (0 if the ringbuf is empty)
+ * @return pointer to the head element, NULL if the ringbuf is empty
+ */
+void *ringbuf_peek_head_span(struct ringbuf *rb, size_t *n)
+{
+    size_t head, slot, avail;
+
+    if (rb->flags & RINGBUF_F_OVERWRITE) {
+        avail = ringbuf_lossy_avail(rb, &head);
+        rb->peek_head = head;
+        rb->peek_avail = avail;
+        slot = ringbuf_idx_slot(rb, head);
+    } else {
+        head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+        slot = ringbuf_idx_slot(rb, head);
+        avail = ringbuf_cons_avail(rb, head, ringbuf_contig(rb, slot));
+    }
+    if (avail > ringbuf_contig(rb, slot)) {
+        avail = ringbuf_contig(rb, slot);
+    }
+    if (!avail) {
+        RINGBUF_STAT_ADD(rb, empty, 1);
+    }
+
+    *n = avail;
+    return avail ? (char *)rb->buf + rb->elem_sz * slot : NULL;
+}
+
+/**
+ * Returns the head element for in-place reading.
+ * @see ringbuf_peek_head_span
+ * @return pointer to the head element, NULL if the ringbuf is empty
+ */
+void *ringbuf_peek_head(struct ringbuf *rb)
+{
+    size_t n;
+
+    return ringbuf_peek_head_span(rb, &n);
+}
+
+/**
+ * Returns all stored elements at the head as up to two contiguous spans,
+ * the second one starting at the beginning of the storage after the wrap
+ * point. Release what was consumed with ringbuf_release_head_n. Consumer
+ * side, see ringbuf_tail_spans.
+ * @param spans set to the stored spans, spans[1].n is 0 if there is no wrap
+ * @return total number of stored elements (spans[0].n + spans[1].n)
+ */
+size_t ringbuf_head_spans(struct ringbuf *rb, struct ringbuf_span spans[2])
+{
+    size_t head, slot, avail, run;
+
+    if (rb->flags & RINGBUF_F_OVERWRITE) {
+        avail = ringbuf_lossy_avail(rb, &head);
+        rb->peek_head = head;
+        rb->peek_avail = avail;
+    } else {
+        head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+        avail = ringbuf_cons_avail(rb, head, rb->capacity);
+    }
+    slot = ringbuf_idx_slot(rb, head);
+    run = ringbuf_contig(rb, slot) < avail ? ringbuf_contig(rb, slot) : avail;
+
+    spans[0].ptr = (char *)rb->buf + rb->elem_sz * slot;
+    spans[0].n = run;
+    spans[1].ptr = (void *)rb->buf;
+    spans[1].n = avail - run;
+    return avail;
+}
+
+/**
+ * Releases n head elements back to the producer.
+ * @param n number of elements consumed in place since the last release
+ * @return 0 on success, -1 if fewer than n elements are stored, or with
+ * RINGBUF_F_OVERWRITE if the producer overwrote the peeked elements
+ */
+int ringbuf_release_head_n(struct ringbuf *rb, size_t n)
+{
+    size_t head;
+
+    if (rb->flags & RINGBUF_F_OVERWRITE) {
+        head = rb->peek_head;
+        if (n > rb->peek_avail) {
+            return -1;
+        }
+        rb->peek_head += n;
+        rb->peek_avail -= n;
+        if (!atomic_compare_exchange_strong_explicit(&rb->head, &head, head + n,
+                    memory_order_release, memory_order_relaxed)) {
+            ringbuf_ctr_add(&rb->lapped, 1);
+            return -1;
+        }
+        RINGBUF_TRACE_OUT(rb, head, n);
+        RINGBUF_STAT_ADD(rb, dequeued, n);
+        ringbuf_notify_prod(rb);
+        return 0;
+    }
+
+    head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    if (n > ringbuf_cons_avail(rb, head, n)) {
+        return -1;
+    }
+
+    if (rb->flags & RINGBUF_F_SCRUB) {
+        ringbuf_scrub(rb, head, n);
+    }
+
+    RINGBUF_TRACE_OUT(rb, head, n);
+    ringbuf_publish_head(rb, ringbuf_idx_add(rb, head, n));
+    RINGBUF_STAT_ADD(rb, dequeued, n);
+    if (rb->flags & RINGBUF_F_SHRINK) {
+        ringbuf_maybe_shrink(rb);
+    }
+    return 0;
+}
+
+/**
+ * Releases the element returned by ringbuf_peek_head.
+ * @return 0 on success, -1 if the ringbuf is empty
+ */
+int ringbuf_release_head(struct ringbuf *rb)
+{
+    return ringbuf_release_head_n(rb, 1);
+}
+
+static void ringbuf_wake(atomic_uint *waiting)
+{
+    atomic_store_explicit(waiting, 0, memory_order_relaxed);
+#ifdef __linux__
+    syscall(SYS_futex, (unsigned *)waiting, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+static long long ringbuf_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Park on waiting until woken or until deadline_ns (CLOCK_MONOTONIC,
+// negative for no deadline), unless ready() succeeds after the flag is
+// raised. Returns 0 if ready() succeeded, 1 if woken (caller retries),
+// -1 on timeout.
+static int ringbuf_park(struct ringbuf *rb, atomic_uint *waiting, long long deadline_ns,
+        int (*ready)(struct ringbuf *rb, void *arg), void *arg)
+{
+    long long left_ns = 0;
+
+    atomic_store_explicit(waiting, 1, memory_order_relaxed);
+    // pairs with the fence in ringbuf_publish_head/tail
+    atomic_thread_fence(memory_order_seq_cst);
+    if ((*ready)(rb, arg) == 0) {
+        atomic_store_explicit(waiting, 0, memory_order_relaxed);
+        return 0;
+    }
+
+    if (deadline_ns >= 0) {
+        left_ns = deadline_ns - ringbuf_now_ns();
+        if (left_ns <= 0) {
+            atomic_store_explicit(waiting, 0, memory_order_relaxed);
+            return -1;
+        }
+    }
+#if RINGBUF_STATS
+    if (waiting == &rb->cons_waiting) {
+        ringbuf_ctr_add(&rb->stat_cons_waits, 1);
+    } else {
+        ringbuf_ctr_add(&rb->stat_prod_waits, 1);
+    }
+#endif
+#ifdef __linux__
+    {
+        struct timespec ts = { left_ns / 1000000000LL, left_ns % 1000000000LL };
+
+        // returns immediately if already woken (flag cleared)
+        syscall(SYS_futex, (unsigned *)waiting, FUTEX_WAIT_PRIVATE, 1,
+                deadline_ns >= 0 ? &ts : NULL, NULL, 0);
+    }
+#else
+    {
+        struct timespec ts = { 0, 100000 };
+
+        nanosleep(&ts, NULL);
+    }
+#endif
+    atomic_store_explicit(waiting, 0, memory_order_relaxed);
+    return 1;
+}
+
+// Wait polls check the count first, so that failed polls do not add to the
+// RINGBUF_STATS empty/full counters.
+static int ringbuf_wait_ready_remove(struct ringbuf *rb, void *elem)
+{
+    if (ringbuf_empty(rb)) {
+        return -1;
+    }
+    return ringbuf_remove_head(rb, elem);
+}
+
+static int ringbuf_wait_ready_add(struct ringbuf *rb, void *elem)
+{
+    if (elem && ringbuf_full(rb) && !(rb->flags & (RINGBUF_F_OVERWRITE | RINGBUF_F_GROW))) {
+        return -1;
+    }
+    return ringbuf_add_tail(rb, elem);
+}
+
+static int ringbuf_wait(struct ringbuf *rb, atomic_uint *waiting, long timeout_ms,
+        int (*ready)(struct ringbuf *rb, void *arg), void *arg)
+{
+    long long deadline_ns = -1;
+    int ret;
+
+    // without the flag the other side never wakes us
+    if (!(rb->flags & RINGBUF_F_WAIT)) {
+        return -1;
+    }
+    for (int i = 0; i < RINGBUF_WAIT_SPINS; i++) {
+        if ((*ready)(rb, arg) == 0) {
+            return 0;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    if (timeout_ms >= 0) {
+        deadline_ns = ringbuf_now_ns() + timeout_ms * 1000000LL;
+    }
+    // ringbuf_park retries ready() itself each time the flag is raised
+    while ((ret = ringbuf_park(rb, waiting, deadline_ns, ready, arg)) > 0) {
+    }
+    return ret;
+}
+
+/**
+ * Removes an element from the head of the ringbuf, waiting for one if
+ * the ringbuf is empty.
+ *
+ * Polls briefly, then sleeps (on a futex on Linux) until the producer adds
+ * an element. Requires RINGBUF_F_WAIT, so that the producer knows to wake
+ * it; the producer only makes a wakeup syscall when a consumer is parked.
+ * Consumer side.
+ * @param elem where to copy the removed element. If NULL, the element is simply removed.
+ * @param timeout_ms maximum time to wait in milliseconds, negative to wait forever
+ * @return 0 on success, -1 on timeout or if RINGBUF_F_WAIT is not set
+ */
+int ringbuf_remove_head_wait(struct ringbuf *rb, void *elem, long timeout_ms)
+{
+    return ringbuf_wait(rb, &rb->cons_waiting, timeout_ms, ringbuf_wait_ready_remove, elem);
+}
+
+/**
+ * Adds an element to the tail of the ringbuf, waiting for room if the
+ * ringbuf is full. Producer side, see ringbuf_remove_head_wait.
+ * @param elem element to add. If NULL, the ringbuf is not modified and 0 is returned.
+ * @param timeout_ms maximum time to wait in milliseconds, negative to wait forever
+ * @return 0 on success, -1 on timeout or if RINGBUF_F_WAIT is not set
+ */
+int ringbuf_add_tail_wait(struct ringbuf *rb, const void *elem, long timeout_ms)
+{
+    return ringbuf_wait(rb, &rb->prod_waiting, timeout_ms, ringbuf_wait_ready_add, (void *)elem);
+}
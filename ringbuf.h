@@ -21,10 +21,158 @@
  * that can hold arbitrarily sized elements.
  */
 
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/**
+ * ringbuf_init_flags() flags.
+ */
+/**
+ * Require a power of two capacity (init fails otherwise). Set automatically
+ * by ringbuf_init when the capacity happens to be a power of two. Indices then
+ * run freely and are wrapped with a mask instead of a compare.
+ */
+#define RINGBUF_F_POW2      (1u << 0)
+/** Zero out slots as elements are removed or released */
+#define RINGBUF_F_SCRUB     (1u << 1)
+/**
+ * Support ringbuf_remove_head_wait/ringbuf_add_tail_wait. Every publish then
+ * also checks (with a full fence) whether the other side is parked.
+ */
+#define RINGBUF_F_WAIT      (1u << 2)
+/** Storage is double-mapped, set by ringbuf_init_mirrored */
+#define RINGBUF_F_MIRRORED  (1u << 3)
+/**
+ * Lossy mode: when full, the producer drops the oldest elements instead of
+ * failing and counts them (see ringbuf_dropped). Implies RINGBUF_F_POW2 and
+ * cannot be combined with RINGBUF_F_SCRUB. Since both sides then move head,
+ * the consumer claims elements with a CAS after copying them and retries
+ * when it was lapped, so it never returns a torn element.
+ */
+#define RINGBUF_F_OVERWRITE (1u << 4)
+/**
+ * Copy large elements (see ringbuf.kern) into the ringbuf with non-temporal
+ * stores, bypassing the producer's cache. Only pays off when the consumer
+ * runs on another core and reads the elements well after they were written
+ * (e.g. a ring much larger than the cache); when they are read back soon,
+ * the stores only add a trip to memory.
+ */
+#define RINGBUF_F_NT        (1u << 5)
+/**
+ * Storage is allocated through a struct ringbuf_allocator and doubled when
+ * the ringbuf fills up, set by ringbuf_init_growable. Resizing moves the
+ * storage, so a growable ringbuf is not safe for a concurrent producer and
+ * consumer; use it from one thread or under a lock.
+ */
+#define RINGBUF_F_GROW      (1u << 6)
+/**
+ * With RINGBUF_F_GROW, halve the capacity again (never below the initial
+ * one) after sustained low occupancy: a full capacity's worth of removals
+ * in a row with fewer than a quarter of the slots used.
+ */
+#define RINGBUF_F_SHRINK    (1u << 7)
+
+/**
+ * Hot-path counters (see ringbuf_stats_snapshot) are only updated when the
+ * library is built with -DRINGBUF_STATS=1. The fields exist either way, so
+ * code built with and without it can share a struct ringbuf.
+ */
+#ifndef RINGBUF_STATS
+#define RINGBUF_STATS 0
+#endif
+
+/**
+ * Queueing delay tracing (see ringbuf_latency_enable) is only compiled in
+ * when the library is built with -DRINGBUF_TRACE=1. Without it the hot
+ * paths carry no tracing code at all and enabling fails.
+ */
+#ifndef RINGBUF_TRACE
+#define RINGBUF_TRACE 0
+#endif
+
+/**
+ * Build with -DRINGBUF_INLINE=1 (or define it before including this
+ * header) to get ringbuf_count, ringbuf_full, ringbuf_empty,
+ * ringbuf_add_tail and ringbuf_remove_head as static inline functions, so
+ * poll loops do not pay for a call into the library. The functions in
+ * ringbuf.c stay available under the same names for everyone else.
+ */
+#ifndef RINGBUF_INLINE
+#define RINGBUF_INLINE 0
+#endif
+
+/**
+ * Element size (bytes) from which elements are prefetched one slot ahead on
+ * dequeue and, with RINGBUF_F_NT, copied in with non-temporal stores.
+ */
+#ifndef RINGBUF_NT_THRESHOLD
+#define RINGBUF_NT_THRESHOLD 1024
+#endif
+
+/** Cache line size assumed for struct ringbuf layout (bytes) */
+#ifndef RINGBUF_CACHELINE
+#define RINGBUF_CACHELINE 64
+#endif
+
+struct ringbuf_kernel;
+
+/** Sub-buckets per power of two in a ringbuf_latency histogram, as a shift */
+#define RINGBUF_LAT_SUB_BITS 4
+/** Number of ringbuf_latency histogram buckets, covering all 64-bit values */
+#define RINGBUF_LAT_BUCKETS ((64 - RINGBUF_LAT_SUB_BITS + 1) << RINGBUF_LAT_SUB_BITS)
+
+/**
+ * Queueing delay histogram of a ringbuf, see ringbuf_latency_enable.
+ *
+ * Log-linear (HDR style) buckets: values below 2^RINGBUF_LAT_SUB_BITS
+ * ticks get one bucket each, every power of two above is split into
+ * 2^RINGBUF_LAT_SUB_BITS buckets, for a relative error under 6.25%. Only
+ * the consumer writes the counters, so any thread may read them while the
+ * ringbuf runs.
+ */
+struct ringbuf_latency {
+    /** Enqueue timestamps, one per slot, parallel to buf */
+    uint64_t *stamps;
+    /** Slots with (slot & sample_mask) == 0 are timed */
+    size_t sample_mask;
+    /** Length of a clock tick (ns) */
+    double ns_per_tick;
+    /** Number of delays recorded */
+    atomic_size_t samples;
+    /** Largest delay recorded (ticks) */
+    atomic_size_t max_ticks;
+    /** Delay counts per bucket */
+    atomic_size_t buckets[RINGBUF_LAT_BUCKETS];
+};
+
+/**
+ * Allocator callbacks for ringbuf_init_growable. The same sz that was passed
+ * to alloc is passed back to free.
+ */
+struct ringbuf_allocator {
+    /** Returns sz bytes of storage suitably aligned for the elements, or NULL */
+    void *(*alloc)(void *ctx, size_t sz);
+    /** Releases storage returned by alloc */
+    void (*free)(void *ctx, void *p, size_t sz);
+    /** Passed to alloc and free */
+    void *ctx;
+};
 
 /**
  * The main ringbuf struct.
+ *
+ * A ringbuf is safe for one producer thread (ringbuf_add_tail) and one
+ * consumer thread (ringbuf_remove_head) to use concurrently without locks.
+ * The producer only ever writes tail and the consumer only ever writes head,
+ * so the two sides never write the same word. Any other sharing (multiple
+ * producers or multiple consumers) still needs external locking.
+ *
+ * The read-only configuration, the producer owned state and the consumer
+ * owned state each sit on their own cache line(s), so pushes and pops on
+ * different cores do not invalidate each other's lines. The struct is
+ * therefore aligned to RINGBUF_CACHELINE; use aligned_alloc() when
+ * allocating one dynamically.
  */
 struct ringbuf {
     /** Base pointer of element array */
@@ -33,12 +181,10 @@ struct ringbuf {
     size_t capacity;  
     /** Size of each element (bytes) */
     size_t elem_sz;
-    /** Head index */
-    size_t head;
-    /** Tail index */
-    size_t tail;
-    /** Number of currently stored elements */
-    size_t count;
+    /** capacity - 1, only meaningful with RINGBUF_F_POW2 */
+    size_t mask;
+    /** RINGBUF_F_* flags */
+    unsigned flags;
 
     /** Function pointers (callbacks) for custom operations */
     struct {
@@ -48,18 +194,377 @@ struct ringbuf {
          * elements to the ringbuf. If not set, memcpy is used by default.
          */ 
         void (*elem_copy)(void *dst, const void *src);
+        /**
+         * Optional batched version of elem_copy: copies n contiguous elements
+         * from src to dst. Bulk operations call it once per contiguous run
+         * (at most twice per call, either side of the wrap point). Takes
+         * precedence over elem_copy, which is only used when this is not set.
+         */
+        void (*elem_copy_n)(void *dst, const void *src, size_t n);
         /** 
          * Optional user provided function to implement printing an element.
          * If not set, elements are not printed.
          */
         void (*elem_print)(const void *elem);
     } ops;
+    /**
+     * Copy kernel picked by ringbuf_init from the element size, the buffer
+     * alignment, the flags and the CPU. Elements of RINGBUF_NT_THRESHOLD
+     * bytes or more (default 1024) are prefetched a slot ahead on dequeue
+     * and, with RINGBUF_F_NT, stored with non-temporal stores when the
+     * slots are suitably aligned.
+     */
+    const struct ringbuf_kernel *kern;
+    /** RINGBUF_F_GROW allocator, NULL for fixed storage */
+    const struct ringbuf_allocator *alloc;
+    /** RINGBUF_F_SHRINK never shrinks below this (the initial capacity) */
+    size_t min_capacity;
+    /** RINGBUF_F_SHRINK: consecutive removals at low occupancy */
+    size_t low_removes;
+    /** RINGBUF_TRACE delay histogram, NULL while tracing is off */
+    struct ringbuf_latency *lat;
+
+    /** Tail index, see head. Written only by the producer. */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t tail;
+    /**
+     * Producer's cached copy of head. Only refreshed from head when it says
+     * there is not enough room, so the producer rarely reads the consumer's line.
+     */
+    size_t head_cache;
+    /** Elements dropped by RINGBUF_F_OVERWRITE. Written only by the producer. */
+    atomic_size_t dropped;
+    /** RINGBUF_STATS producer counters, see struct ringbuf_stats */
+    atomic_size_t stat_enqueued, stat_full, stat_high_water, stat_prod_waits;
+
+    /**
+     * Head index. Written only by the consumer, except that with
+     * RINGBUF_F_OVERWRITE the producer also advances it (by CAS) to drop.
+     * With RINGBUF_F_POW2 indices run freely and are masked on access,
+     * otherwise they stay in the range [0, 2 * capacity). Either way
+     * head == tail means empty and a distance of capacity means full,
+     * without a separate shared count.
+     */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t head;
+    /** Consumer's cached copy of tail, see head_cache. */
+    size_t tail_cache;
+    /**
+     * RINGBUF_F_OVERWRITE: times the consumer lost an element it was copying
+     * or peeking to the producer. Written only by the consumer.
+     */
+    atomic_size_t lapped;
+    /** RINGBUF_F_OVERWRITE: head and element count of the last peek */
+    size_t peek_head, peek_avail;
+    /** RINGBUF_STATS consumer counters, see struct ringbuf_stats */
+    atomic_size_t stat_dequeued, stat_empty, stat_cons_waits;
+
+    /**
+     * Nonzero while the consumer is parked in ringbuf_remove_head_wait
+     * (futex word). Kept apart from head and tail, it is only written
+     * when a side parks or is woken.
+     */
+    _Alignas(RINGBUF_CACHELINE) atomic_uint cons_waiting;
+    /** Nonzero while the producer is parked in ringbuf_add_tail_wait */
+    atomic_uint prod_waiting;
+};
+
+/**
+ * A contiguous run of n slots, see ringbuf_tail_spans, ringbuf_head_spans
+ * and ringbuf_range
+ */
+struct ringbuf_span {
+    /** First slot */
+    void *ptr;
+    /** Number of slots */
+    size_t n;
+};
+
+/**
+ * Counters returned by ringbuf_stats_snapshot. Everything but count,
+ * dropped, lapped and the lat_* fields stays 0 unless built with
+ * RINGBUF_STATS.
+ */
+struct ringbuf_stats {
+    /** Elements added */
+    size_t enqueued;
+    /** Elements removed or released */
+    size_t dequeued;
+    /** Adds, reserves and commits that failed (or fell short) on a full ringbuf */
+    size_t full;
+    /** Removes and peeks that found the ringbuf empty */
+    size_t empty;
+    /**
+     * Highest count seen by the producer. It works from its cached head, so
+     * this can overestimate the true peak, never underestimate it.
+     */
+    size_t high_water;
+    /** Elements dropped by RINGBUF_F_OVERWRITE */
+    size_t dropped;
+    /** Times a RINGBUF_F_OVERWRITE consumer was lapped */
+    size_t lapped;
+    /** Times the producer slept in ringbuf_add_tail_wait */
+    size_t prod_waits;
+    /** Times the consumer slept in ringbuf_remove_head_wait */
+    size_t cons_waits;
+    /** Elements stored at the time of the snapshot */
+    size_t count;
+    /** Queueing delays recorded, 0 unless tracing (see ringbuf_latency_enable) */
+    size_t lat_samples;
+    /** Median, 99th percentile and largest queueing delay (ns) */
+    uint64_t lat_p50_ns, lat_p99_ns, lat_max_ns;
 };
 
 int ringbuf_init(struct ringbuf *rb, const void *buf, size_t n_elem, size_t elem_sz);
+int ringbuf_init_flags(struct ringbuf *rb, const void *buf, size_t n_elem, size_t elem_sz,
+        unsigned flags);
+int ringbuf_init_mirrored(struct ringbuf *rb, size_t n_elem, size_t elem_sz, unsigned flags);
+void ringbuf_free_mirrored(struct ringbuf *rb);
+int ringbuf_init_growable(struct ringbuf *rb, size_t n_elem, size_t elem_sz, unsigned flags,
+        const struct ringbuf_allocator *alloc);
+void ringbuf_free_growable(struct ringbuf *rb);
+size_t ringbuf_count(const struct ringbuf *rb);
 int ringbuf_full(const struct ringbuf *rb);
 int ringbuf_empty(const struct ringbuf *rb);
+size_t ringbuf_dropped(const struct ringbuf *rb);
+const char *ringbuf_copy_kernel(const struct ringbuf *rb);
+void ringbuf_stats_snapshot(const struct ringbuf *rb, struct ringbuf_stats *st);
+int ringbuf_latency_enable(struct ringbuf *rb, struct ringbuf_latency *lat, uint64_t *stamps,
+        unsigned sample_shift);
+void ringbuf_latency_disable(struct ringbuf *rb);
+uint64_t ringbuf_latency_bucket_ns(const struct ringbuf_latency *lat, size_t bucket);
+uint64_t ringbuf_latency_percentile_ns(const struct ringbuf_latency *lat, double pct);
 int ringbuf_add_tail(struct ringbuf *rb, const void *elem);
 int ringbuf_remove_head(struct ringbuf *rb, void *elem);
+size_t ringbuf_add_tail_n(struct ringbuf *rb, const void *elems, size_t n);
+size_t ringbuf_remove_head_n(struct ringbuf *rb, void *elems, size_t n);
+void *ringbuf_reserve_tail(struct ringbuf *rb);
+void *ringbuf_reserve_tail_span(struct ringbuf *rb, size_t *n);
+int ringbuf_commit_tail(struct ringbuf *rb);
+int ringbuf_commit_tail_n(struct ringbuf *rb, size_t n);
+void *ringbuf_peek_head(struct ringbuf *rb);
+void *ringbuf_peek_head_span(struct ringbuf *rb, size_t *n);
+int ringbuf_release_head(struct ringbuf *rb);
+int ringbuf_release_head_n(struct ringbuf *rb, size_t n);
+size_t ringbuf_tail_spans(struct ringbuf *rb, struct ringbuf_span spans[2]);
+size_t ringbuf_head_spans(struct ringbuf *rb, struct ringbuf_span spans[2]);
+void *ringbuf_at(const struct ringbuf *rb, size_t i);
+size_t ringbuf_range(const struct ringbuf *rb, size_t start, size_t n,
+        struct ringbuf_span spans[2]);
+int ringbuf_remove_head_wait(struct ringbuf *rb, void *elem, long timeout_ms);
+int ringbuf_add_tail_wait(struct ringbuf *rb, const void *elem, long timeout_ms);
+
+/*
+ * Index helpers, shared by ringbuf.c and the RINGBUF_INLINE operations.
+ * With RINGBUF_F_POW2 indices run freely and unsigned wraparound keeps
+ * tail - head correct. Otherwise indices run over [0, 2 * capacity) so full
+ * and empty can still be told apart from head and tail alone. Neither case
+ * needs a division.
+ */
+static inline size_t ringbuf_idx_add(const struct ringbuf *rb, size_t idx, size_t n)
+{
+    if (rb->flags & RINGBUF_F_POW2) {
+        return idx + n;
+    }
+    idx += n;
+    return (idx >= 2 * rb->capacity) ? idx - 2 * rb->capacity : idx;
+}
+
+static inline size_t ringbuf_idx_slot(const struct ringbuf *rb, size_t idx)
+{
+    if (rb->flags & RINGBUF_F_POW2) {
+        return idx & rb->mask;
+    }
+    return (idx < rb->capacity) ? idx : idx - rb->capacity;
+}
+
+static inline size_t ringbuf_idx_dist(const struct ringbuf *rb, size_t head, size_t tail)
+{
+    if (rb->flags & RINGBUF_F_POW2) {
+        return tail - head;
+    }
+    return (tail >= head) ? tail - head : tail + 2 * rb->capacity - head;
+}
+
+/*
+ * Add to a counter that only one side ever writes: a relaxed load and store
+ * is enough, readers just need to see a whole value.
+ */
+static inline void ringbuf_ctr_add(atomic_size_t *ctr, size_t n)
+{
+    atomic_store_explicit(ctr, atomic_load_explicit(ctr, memory_order_relaxed) + n,
+            memory_order_relaxed);
+}
+
+
+/**
+ * Declares a ringbuf specialized for a fixed element type and capacity.
+ *
+ * Generates struct name with embedded storage for n_elem elements of type,
+ * and static inline name_init/name_count/name_full/name_empty/
+ * name_add_tail/name_remove_head functions. Since the element size and
+ * capacity are compile-time constants, copies become plain moves and index
+ * wrapping a constant mask. Same single-producer/single-consumer rules and
+ * cache line layout as struct ringbuf, but without ops callbacks.
+ *
+ * Example: RINGBUF_DECLARE(int_queue, int, 64)
+ *
+ * @param name name of the generated struct and function prefix
+ * @param type element type
+ * @param n_elem capacity, must be a power of two
+ */
+#define RINGBUF_DECLARE(name, type, n_elem)                                   \
+_Static_assert((n_elem) > 0 && ((n_elem) & ((n_elem) - 1)) == 0,             \
+        #name ": capacity must be a power of two");                          \
+                                                                             \
+struct name {                                                                \
+    type buf[n_elem];                                                        \
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t tail;                          \
+    size_t head_cache;                                                       \
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t head;                          \
+    size_t tail_cache;                                                       \
+};                                                                           \
+                                                                             \
+static inline void name##_init(struct name *rb)                              \
+{                                                                            \
+    atomic_init(&rb->head, 0);                                               \
+    atomic_init(&rb->tail, 0);                                               \
+    rb->head_cache = 0;                                                      \
+    rb->tail_cache = 0;                                                      \
+}                                                                            \
+                                                                             \
+static inline size_t name##_count(const struct name *rb)                     \
+{                                                                            \
+    return atomic_load_explicit(&rb->tail, memory_order_acquire) -           \
+        atomic_load_explicit(&rb->head, memory_order_acquire);               \
+}                                                                            \
+                                                                             \
+static inline int name##_full(const struct name *rb)                         \
+{                                                                            \
+    return name##_count(rb) == (n_elem);                                     \
+}                                                                            \
+                                                                             \
+static inline int name##_empty(const struct name *rb)                        \
+{                                                                            \
+    return name##_count(rb) == 0;                                            \
+}                                                                            \
+                                                                             \
+static inline int name##_add_tail(struct name *rb, const type *elem)         \
+{                                                                            \
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);     \
+                                                                             \
+    if (tail - rb->head_cache == (n_elem)) {                                 \
+        rb->head_cache = atomic_load_explicit(&rb->head, memory_order_acquire); \
+        if (tail - rb->head_cache == (n_elem)) {                             \
+            return -1;                                                       \
+        }                                                                    \
+    }                                                                        \
+    rb->buf[tail & ((n_elem) - 1)] = *elem;                                  \
+    atomic_store_explicit(&rb->tail, tail + 1, memory_order_release);        \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+static inline int name##_remove_head(struct name *rb, type *elem)            \
+{                                                                            \
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);     \
+                                                                             \
+    if (head == rb->tail_cache) {                                            \
+        rb->tail_cache = atomic_load_explicit(&rb->tail, memory_order_acquire); \
+        if (head == rb->tail_cache) {                                        \
+            return -1;                                                       \
+        }                                                                    \
+    }                                                                        \
+    if (elem) {                                                              \
+        *elem = rb->buf[head & ((n_elem) - 1)];                              \
+    }                                                                        \
+    atomic_store_explicit(&rb->head, head + 1, memory_order_release);        \
+    return 0;                                                                \
+}
+
+#if RINGBUF_INLINE
+#include <string.h>
+
+/*
+ * RINGBUF_INLINE fast paths. They handle plain rings (no callbacks, no
+ * tracing, small elements and none of the flags below) when the operation
+ * succeeds, and call the library for everything else, so results and
+ * counters match the out-of-line functions exactly. Build with the same
+ * RINGBUF_STATS setting as the library.
+ */
+#define RINGBUF_INLINE_SLOW_FLAGS (RINGBUF_F_SCRUB | RINGBUF_F_WAIT | RINGBUF_F_OVERWRITE | \
+        RINGBUF_F_GROW | RINGBUF_F_SHRINK)
+
+static inline int ringbuf_inline_ok(const struct ringbuf *rb)
+{
+    return !(rb->flags & RINGBUF_INLINE_SLOW_FLAGS) && rb->elem_sz < RINGBUF_NT_THRESHOLD &&
+            !rb->ops.elem_copy && !rb->ops.elem_copy_n && !rb->ops.elem_print && !rb->lat;
+}
+
+static inline size_t ringbuf_count_inline(const struct ringbuf *rb)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t count = ringbuf_idx_dist(rb, head, tail);
+
+    return count > rb->capacity ? rb->capacity : count;
+}
+
+static inline int ringbuf_full_inline(const struct ringbuf *rb)
+{
+    return ringbuf_count_inline(rb) == rb->capacity;
+}
+
+static inline int ringbuf_empty_inline(const struct ringbuf *rb)
+{
+    return 0 == ringbuf_count_inline(rb);
+}
+
+static inline int ringbuf_add_tail_inline(struct ringbuf *rb, const void *elem)
+{
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t next;
+
+    if (!elem || !ringbuf_inline_ok(rb) ||
+            ringbuf_idx_dist(rb, rb->head_cache, tail) == rb->capacity) {
+        // full by the cached head: let the library refresh it (and count)
+        return ringbuf_add_tail(rb, elem);
+    }
+    memcpy((char *)rb->buf + rb->elem_sz * ringbuf_idx_slot(rb, tail), elem, rb->elem_sz);
+    next = ringbuf_idx_add(rb, tail, 1);
+    atomic_store_explicit(&rb->tail, next, memory_order_release);
+#if RINGBUF_STATS
+    ringbuf_ctr_add(&rb->stat_enqueued, 1);
+    if (ringbuf_idx_dist(rb, rb->head_cache, next) >
+            atomic_load_explicit(&rb->stat_high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&rb->stat_high_water, ringbuf_idx_dist(rb, rb->head_cache, next),
+                memory_order_relaxed);
+    }
+#endif
+    return 0;
+}
+
+static inline int ringbuf_remove_head_inline(struct ringbuf *rb, void *elem)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+
+    if (!ringbuf_inline_ok(rb) || head == rb->tail_cache) {
+        // empty by the cached tail: let the library refresh it (and count)
+        return ringbuf_remove_head(rb, elem);
+    }
+    if (elem) {
+        memcpy(elem, (const char *)rb->buf + rb->elem_sz * ringbuf_idx_slot(rb, head),
+                rb->elem_sz);
+    }
+    atomic_store_explicit(&rb->head, ringbuf_idx_add(rb, head, 1), memory_order_release);
+#if RINGBUF_STATS
+    ringbuf_ctr_add(&rb->stat_dequeued, 1);
+#endif
+    return 0;
+}
+
+#define ringbuf_count(rb) ringbuf_count_inline(rb)
+#define ringbuf_full(rb) ringbuf_full_inline(rb)
+#define ringbuf_empty(rb) ringbuf_empty_inline(rb)
+#define ringbuf_add_tail(rb, elem) ringbuf_add_tail_inline(rb, elem)
+#define ringbuf_remove_head(rb, elem) ringbuf_remove_head_inline(rb, elem)
+#endif
 
 #endif
@@ -0,0 +1,233 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_bcast.c Single-producer/multi-reader broadcast ringbuf.
+ *
+ * Positions run freely and are masked on access, as with RINGBUF_F_POW2.
+ * Reader r has tail - head[r] unread elements; the producer has room for
+ * capacity - (tail - min(head)) more.
+ */
+#include <string.h>
+
+#include "ringbuf_bcast.h"
+
+// Scan the active readers for the one furthest behind tail. Without any
+// active reader the producer is never held up.
+static size_t ringbuf_bcast_min_head(struct ringbuf_bcast *rb, size_t tail)
+{
+    size_t min = tail, head;
+
+    for (size_t i = 0; i < rb->n_readers; i++) {
+        if (!atomic_load_explicit(&rb->readers[i].active, memory_order_acquire)) {
+            continue;
+        }
+        // acquire: the reader is done with slots before its head
+        head = atomic_load_explicit(&rb->readers[i].head, memory_order_acquire);
+        if (tail - head > tail - min) {
+            min = head;
+        }
+    }
+    return min;
+}
+
+// free slots at tail, refreshing the cached slowest head only when needed
+static size_t ringbuf_bcast_room(struct ringbuf_bcast *rb, size_t tail)
+{
+    if (rb->capacity - (tail - rb->min_head_cache) == 0) {
+        rb->min_head_cache = ringbuf_bcast_min_head(rb, tail);
+    }
+    return rb->capacity - (tail - rb->min_head_cache);
+}
+
+// elements reader r has not read yet
+static size_t ringbuf_bcast_avail(struct ringbuf_bcast *rb, struct ringbuf_bcast_reader *r,
+        size_t head)
+{
+    if (r->tail_cache == head) {
+        // acquire: pairs with the producer's release of tail
+        r->tail_cache = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    }
+    return r->tail_cache - head;
+}
+
+/**
+ * Initialize a ringbuf_bcast struct.
+ *
+ * Same external storage model as ringbuf_init: buf must hold n_elem
+ * elements of elem_sz bytes, and readers must point to n_readers reader
+ * structs. All readers start active at position 0. No memory allocation
+ * is performed.
+ *
+ * @param rb pointer to the ringbuf_bcast struct to initialize
+ * @param buf pointer to the array buffer
+ * @param readers pointer to the reader state array
+ * @param n_readers number of readers
+ * @param n_elem maximum number of elements buf can hold, must be a power of two
+ * @param elem_sz the size (bytes) of each element
+ * @return 0 on success, -1 if rb, buf or readers are NULL, n_readers is 0
+ * or n_elem is not a power of two
+ */
+int ringbuf_bcast_init(struct ringbuf_bcast *rb, const void *buf,
+        struct ringbuf_bcast_reader *readers, size_t n_readers, size_t n_elem, size_t elem_sz)
+{
+    if (!rb || !buf || !readers || !n_readers) {
+        return -1;
+    }
+    if (!n_elem || (n_elem & (n_elem - 1))) {
+        return -1;
+    }
+
+    rb->buf = buf;
+    rb->readers = readers;
+    rb->n_readers = n_readers;
+    rb->capacity = n_elem;
+    rb->mask = n_elem - 1;
+    rb->elem_sz = elem_sz;
+    for (size_t i = 0; i < n_readers; i++) {
+        atomic_init(&readers[i].head, 0);
+        readers[i].tail_cache = 0;
+        atomic_init(&readers[i].active, 1);
+    }
+    atomic_init(&rb->tail, 0);
+    rb->min_head_cache = 0;
+
+    return 0;
+}
+
+/**
+ * Returns the number of elements reader has not read yet.
+ *
+ * Only a snapshot when called concurrently with the producer or the reader.
+ */
+size_t ringbuf_bcast_count(const struct ringbuf_bcast *rb, size_t reader)
+{
+    size_t head = atomic_load_explicit(&rb->readers[reader].head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+    return tail - head;
+}
+
+/**
+ * Reserves the next slot at the tail for in-place writing. Producer side.
+ * @return pointer to the slot, NULL if the slowest reader has not released it yet
+ */
+void *ringbuf_bcast_reserve_tail(struct ringbuf_bcast *rb)
+{
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+    if (!ringbuf_bcast_room(rb, tail)) {
+        return NULL;
+    }
+    return (char *)rb->buf + rb->elem_sz * (tail & rb->mask);
+}
+
+/**
+ * Publishes the slot returned by ringbuf_bcast_reserve_tail to all readers.
+ * @return 0 on success, -1 if the ringbuf is full
+ */
+int ringbuf_bcast_commit_tail(struct ringbuf_bcast *rb)
+{
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+    if (!ringbuf_bcast_room(rb, tail)) {
+        return -1;
+    }
+    atomic_store_explicit(&rb->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Adds a copy of elem for all readers. Producer side.
+ * @param elem element to add. If NULL, the ringbuf is not modified and 0 is returned.
+ * @return 0 on success, -1 if the ringbuf is full
+ */
+int ringbuf_bcast_add_tail(struct ringbuf_bcast *rb, const void *elem)
+{
+    void *tp;
+
+    if (!elem) {
+        return 0;
+    }
+    tp = ringbuf_bcast_reserve_tail(rb);
+    if (!tp) {
+        return -1;
+    }
+    memcpy(tp, elem, rb->elem_sz);
+    return ringbuf_bcast_commit_tail(rb);
+}
+
+/**
+ * Returns a contiguous run of unread elements for in-place reading.
+ *
+ * The elements stay valid until they are released with
+ * ringbuf_bcast_release. Reader side, only the thread owning reader may
+ * call this.
+ * @param n set to the number of contiguous unread elements before the wrap
+ * point (0 if there are none)
+ * @return pointer to the first unread element, NULL if there are none
+ */
+const void *ringbuf_bcast_peek(struct ringbuf_bcast *rb, size_t reader, size_t *n)
+{
+    struct ringbuf_bcast_reader *r = &rb->readers[reader];
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t slot = head & rb->mask;
+    size_t avail = ringbuf_bcast_avail(rb, r, head);
+
+    if (avail > rb->capacity - slot) {
+        avail = rb->capacity - slot;
+    }
+    *n = avail;
+    return avail ? (const char *)rb->buf + rb->elem_sz * slot : NULL;
+}
+
+/**
+ * Releases n elements read in place by reader, letting the producer reuse
+ * their slots once every other reader has released them too.
+ * @return 0 on success, -1 if reader has fewer than n unread elements
+ */
+int ringbuf_bcast_release(struct ringbuf_bcast *rb, size_t reader, size_t n)
+{
+    struct ringbuf_bcast_reader *r = &rb->readers[reader];
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    if (n > ringbuf_bcast_avail(rb, r, head)) {
+        r->tail_cache = atomic_load_explicit(&rb->tail, memory_order_acquire);
+        if (n > r->tail_cache - head) {
+            return -1;
+        }
+    }
+    // release: our reads of the slots are done before the producer reuses them
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+    return 0;
+}
+
+/**
+ * Copies out and releases the next unread element of reader.
+ * @param elem where to copy the element. If NULL, the element is simply skipped.
+ * @return 0 on success, -1 if there is no unread element
+ */
+int ringbuf_bcast_read(struct ringbuf_bcast *rb, size_t reader, void *elem)
+{
+    const void *hp;
+    size_t n;
+
+    hp = ringbuf_bcast_peek(rb, reader, &n);
+    if (!hp) {
+        return -1;
+    }
+    if (elem) {
+        memcpy(elem, hp, rb->elem_sz);
+    }
+    return ringbuf_bcast_release(rb, reader, 1);
+}
+
+/**
+ * Stops the producer from waiting on reader. The reader must not read
+ * again afterwards. Safe to call from any thread.
+ */
+void ringbuf_bcast_detach(struct ringbuf_bcast *rb, size_t reader)
+{
+    atomic_store_explicit(&rb->readers[reader].active, 0, memory_order_release);
+}
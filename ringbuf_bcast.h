@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_BCAST_H__
+#define __RINGBUF_BCAST_H__
+
+/**
+ * @file ringbuf_bcast.h Broadcast ringbuf: one producer, N readers that
+ * each see every element.
+ */
+
+#include "ringbuf.h"
+
+/**
+ * Per-reader state of a ringbuf_bcast, one cache line each so readers do
+ * not slow each other down.
+ */
+struct ringbuf_bcast_reader {
+    /** Next position this reader will read. Written only by the reader. */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t head;
+    /** Reader's cached copy of the producer's tail */
+    size_t tail_cache;
+    /** Nonzero while the producer waits for this reader */
+    atomic_int active;
+};
+
+/**
+ * Single-producer/multi-reader broadcast ringbuf (disruptor style).
+ *
+ * There is one tail and one head per reader over the same storage. Every
+ * reader sees every element, in place, so fanning a stream out to N
+ * readers costs no copies beyond the one into the ringbuf. The producer
+ * gates on the slowest active reader: an element's slot is only reused
+ * once all readers have released it.
+ *
+ * The producer and each reader may run on their own thread without locks.
+ * A reader that goes away must call ringbuf_bcast_detach, or the producer
+ * eventually stalls on it.
+ */
+struct ringbuf_bcast {
+    /** Base pointer of element array */
+    const void *buf;
+    /** Reader state, n_readers entries */
+    struct ringbuf_bcast_reader *readers;
+    /** Number of readers */
+    size_t n_readers;
+    /** Maximum number of elements that can be stored, a power of two */
+    size_t capacity;
+    /** capacity - 1 */
+    size_t mask;
+    /** Size of each element (bytes) */
+    size_t elem_sz;
+
+    /** Next position the producer writes. Written only by the producer. */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t tail;
+    /**
+     * Producer's cached copy of the slowest reader's head. Refreshed by
+     * scanning the readers only when it says there is no room.
+     */
+    size_t min_head_cache;
+};
+
+int ringbuf_bcast_init(struct ringbuf_bcast *rb, const void *buf,
+        struct ringbuf_bcast_reader *readers, size_t n_readers, size_t n_elem, size_t elem_sz);
+size_t ringbuf_bcast_count(const struct ringbuf_bcast *rb, size_t reader);
+int ringbuf_bcast_add_tail(struct ringbuf_bcast *rb, const void *elem);
+void *ringbuf_bcast_reserve_tail(struct ringbuf_bcast *rb);
+int ringbuf_bcast_commit_tail(struct ringbuf_bcast *rb);
+int ringbuf_bcast_read(struct ringbuf_bcast *rb, size_t reader, void *elem);
+const void *ringbuf_bcast_peek(struct ringbuf_bcast *rb, size_t reader, size_t *n);
+int ringbuf_bcast_release(struct ringbuf_bcast *rb, size_t reader, size_t n);
+void ringbuf_bcast_detach(struct ringbuf_bcast *rb, size_t reader);
+
+#endif
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_bcast_test.c Example usage for the broadcast ringbuf.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ringbuf_bcast.h"
+
+#define ELEMS_BUF_LEN 8
+#define N_READERS 3
+#define N_ITEMS 100000
+
+struct my_struct {
+    int id;
+    char name[16];
+};
+
+static void test_bcast_gating(void)
+{
+    int buf[ELEMS_BUF_LEN];
+    struct ringbuf_bcast_reader readers[2];
+    struct ringbuf_bcast rb;
+    const int *p;
+    int my_elem;
+    size_t n;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_bcast_init(&rb, buf, readers, 2, ELEMS_BUF_LEN - 1, sizeof(int)));
+    assert(-1 == ringbuf_bcast_init(&rb, buf, readers, 0, ELEMS_BUF_LEN, sizeof(int)));
+    assert(0 == ringbuf_bcast_init(&rb, buf, readers, 2, ELEMS_BUF_LEN, sizeof(int)));
+
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == ringbuf_bcast_add_tail(&rb, &i));
+    }
+    assert(-1 == ringbuf_bcast_add_tail(&rb, &my_elem)); // full
+
+    // reader 0 reads everything, the producer still waits for reader 1
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == ringbuf_bcast_read(&rb, 0, &my_elem) && my_elem == i);
+    }
+    assert(-1 == ringbuf_bcast_read(&rb, 0, &my_elem));
+    assert(0 == ringbuf_bcast_count(&rb, 0) && ELEMS_BUF_LEN == ringbuf_bcast_count(&rb, 1));
+    assert(NULL == ringbuf_bcast_reserve_tail(&rb));
+
+    // reader 1 reads in place, from the same storage
+    p = ringbuf_bcast_peek(&rb, 1, &n);
+    assert(p == (const int *)buf && n == ELEMS_BUF_LEN);
+    assert(-1 == ringbuf_bcast_release(&rb, 1, ELEMS_BUF_LEN + 1));
+    assert(0 == ringbuf_bcast_release(&rb, 1, 3));
+    for (int i = 0; i < 3; i++) {
+        assert(0 == ringbuf_bcast_add_tail(&rb, &i));
+    }
+    assert(-1 == ringbuf_bcast_add_tail(&rb, &my_elem));
+
+    // a detached reader no longer holds the producer up
+    ringbuf_bcast_detach(&rb, 1);
+    for (int i = 0; i < 5; i++) {
+        assert(0 == ringbuf_bcast_add_tail(&rb, &i));
+    }
+    assert(-1 == ringbuf_bcast_add_tail(&rb, &my_elem)); // reader 0 is full
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void *bcast_reader(void *arg)
+{
+    struct ringbuf_bcast *rb = ((void **)arg)[0];
+    size_t reader = (size_t)((void **)arg)[1];
+    const struct my_struct *p;
+    char expect[16];
+    int next = 0;
+    size_t n;
+
+    while (next < N_ITEMS) {
+        p = ringbuf_bcast_peek(rb, reader, &n);
+        if (!p) {
+            sched_yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; i++, next++) {
+            snprintf(expect, sizeof(expect), "name_%d", next);
+            assert(p[i].id == next && 0 == strcmp(p[i].name, expect));
+        }
+        assert(0 == ringbuf_bcast_release(rb, reader, n));
+    }
+    return NULL;
+}
+
+// one producer, N_READERS reader threads that each see every element
+static void test_bcast_threads(void)
+{
+    struct my_struct buf[ELEMS_BUF_LEN], *p;
+    struct ringbuf_bcast_reader readers[N_READERS];
+    struct ringbuf_bcast rb;
+    pthread_t threads[N_READERS];
+    void *args[N_READERS][2];
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_bcast_init(&rb, buf, readers, N_READERS, ELEMS_BUF_LEN, sizeof(buf[0])));
+    for (size_t i = 0; i < N_READERS; i++) {
+        args[i][0] = &rb;
+        args[i][1] = (void *)i;
+        assert(0 == pthread_create(&threads[i], NULL, bcast_reader, args[i]));
+    }
+
+    for (int i = 0; i < N_ITEMS; i++) {
+        while ((p = ringbuf_bcast_reserve_tail(&rb)) == NULL) {
+            sched_yield();
+        }
+        p->id = i;
+        snprintf(p->name, sizeof(p->name), "name_%d", i);
+        assert(0 == ringbuf_bcast_commit_tail(&rb));
+    }
+
+    for (int i = 0; i < N_READERS; i++) {
+        assert(0 == pthread_join(threads[i], NULL));
+        assert(0 == ringbuf_bcast_count(&rb, i));
+    }
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_bcast_gating();
+    test_bcast_threads();
+
+    return 0;
+}
@@ -0,0 +1,529 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_bench.c Throughput and latency microbenchmarks.
+ *
+ * Runs every API over element sizes of 1, 8, 64 and 1024 bytes, a cache
+ * resident and a DRAM sized buffer, single-threaded and with producer and
+ * consumer on separate threads (pinned to different CPUs when there are
+ * several). Results are printed as CSV on stdout, one line per run:
+ *
+ *   api,threads,elem_sz,capacity,batch,ops,secs,mops,
+ *   push_p50_ns,push_p99_ns,push_p999_ns,pop_p50_ns,pop_p99_ns,pop_p999_ns
+ *
+ * Latencies are per call (a call moves up to batch elements) and sampled
+ * every LAT_SAMPLE_EVERY calls, with the timer overhead subtracted.
+ *
+ * Usage: ringbuf_bench [-n min_ops] [-a api]
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ringbuf.h"
+#include "ringbuf_mpmc.h"
+
+#define CACHE_BYTES (16 * 1024)
+#define DRAM_BYTES (32 * 1024 * 1024)
+#define BATCH 32
+#define LAT_SAMPLE_EVERY 64
+#define LAT_MAX_SAMPLES (1 << 16)
+
+struct bench_elem_1 { unsigned char b[1]; };
+struct bench_elem_8 { unsigned char b[8]; };
+struct bench_elem_64 { unsigned char b[64]; };
+struct bench_elem_1024 { unsigned char b[1024]; };
+
+RINGBUF_DECLARE(q1c, struct bench_elem_1, CACHE_BYTES / 1)
+RINGBUF_DECLARE(q8c, struct bench_elem_8, CACHE_BYTES / 8)
+RINGBUF_DECLARE(q64c, struct bench_elem_64, CACHE_BYTES / 64)
+RINGBUF_DECLARE(q1024c, struct bench_elem_1024, CACHE_BYTES / 1024)
+RINGBUF_DECLARE(q1d, struct bench_elem_1, DRAM_BYTES / 1)
+RINGBUF_DECLARE(q8d, struct bench_elem_8, DRAM_BYTES / 8)
+RINGBUF_DECLARE(q64d, struct bench_elem_64, DRAM_BYTES / 64)
+RINGBUF_DECLARE(q1024d, struct bench_elem_1024, DRAM_BYTES / 1024)
+
+struct lat {
+    uint64_t samples[LAT_MAX_SAMPLES];
+    size_t n;
+};
+
+struct bench_ctx {
+    size_t elem_sz;
+    size_t n_elem;
+    size_t ops;
+    void *buf;
+    atomic_size_t *seq;
+    void *typed;
+    struct ringbuf rb;
+    struct ringbuf_mpmc mpmc;
+    struct lat push_lat;
+    struct lat pop_lat;
+    volatile unsigned sink;
+};
+
+typedef size_t (*bench_push_fn)(struct bench_ctx *c, const void *src);
+typedef size_t (*bench_pop_fn)(struct bench_ctx *c, void *dst);
+
+static long n_cpus;
+static uint64_t timer_overhead;
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void calibrate_timer(void)
+{
+    uint64_t t0, best = UINT64_MAX;
+
+    for (int i = 0; i < 10000; i++) {
+        t0 = now_ns();
+        if (now_ns() - t0 < best) {
+            best = now_ns() - t0;
+        }
+    }
+    timer_overhead = best;
+}
+
+static inline void lat_add(struct lat *l, uint64_t ns)
+{
+    if (l->n < LAT_MAX_SAMPLES) {
+        l->samples[l->n++] = ns > timer_overhead ? ns - timer_overhead : 0;
+    }
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t lat_pct(struct lat *l, double pct)
+{
+    if (!l->n) {
+        return 0;
+    }
+    return l->samples[(size_t)(pct * (l->n - 1))];
+}
+
+static inline void backoff(void)
+{
+    if (n_cpus == 1) {
+        sched_yield();
+    } else {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+}
+
+static void pin_self(long cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu % n_cpus, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Single-threaded: fill the ring, then drain it, until ops elements
+// have passed through. Always inlined so push/pop are inlined too.
+static inline __attribute__((always_inline))
+void bench_run_st(struct bench_ctx *c, bench_push_fn push, bench_pop_fn pop,
+        const void *src, void *dst)
+{
+    size_t moved = 0, calls = 0, n;
+    uint64_t t0;
+
+    while (moved < c->ops) {
+        for (;;) {
+            if (++calls % LAT_SAMPLE_EVERY == 0) {
+                t0 = now_ns();
+                n = push(c, src);
+                lat_add(&c->push_lat, now_ns() - t0);
+            } else {
+                n = push(c, src);
+            }
+            if (!n) {
+                break;
+            }
+        }
+        for (;;) {
+            if (++calls % LAT_SAMPLE_EVERY == 0) {
+                t0 = now_ns();
+                n = pop(c, dst);
+                lat_add(&c->pop_lat, now_ns() - t0);
+            } else {
+                n = pop(c, dst);
+            }
+            if (!n) {
+                break;
+            }
+            moved += n;
+        }
+    }
+}
+
+static inline __attribute__((always_inline))
+void bench_run_producer(struct bench_ctx *c, bench_push_fn push, const void *src)
+{
+    size_t moved = 0, calls = 0, n;
+    uint64_t t0;
+
+    pin_self(0);
+    while (moved < c->ops) {
+        if (++calls % LAT_SAMPLE_EVERY == 0) {
+            t0 = now_ns();
+            n = push(c, src);
+            if (n) {
+                lat_add(&c->push_lat, now_ns() - t0);
+            }
+        } else {
+            n = push(c, src);
+        }
+        if (!n) {
+            backoff();
+        }
+        moved += n;
+    }
+}
+
+static inline __attribute__((always_inline))
+void bench_run_consumer(struct bench_ctx *c, bench_pop_fn pop, void *dst)
+{
+    size_t moved = 0, calls = 0, n;
+    uint64_t t0;
+
+    pin_self(1);
+    while (moved < c->ops) {
+        if (++calls % LAT_SAMPLE_EVERY == 0) {
+            t0 = now_ns();
+            n = pop(c, dst);
+            if (n) {
+                lat_add(&c->pop_lat, now_ns() - t0);
+            }
+        } else {
+            n = pop(c, dst);
+        }
+        if (!n) {
+            backoff();
+        }
+        moved += n;
+    }
+}
+
+/*
+ * Generates the per-API entry points. PUSH and POP are expressions over
+ * c, src and dst that evaluate to the number of elements moved.
+ */
+#define BENCH_DEFINE(api, PUSH, POP)                                          \
+static size_t api##_push(struct bench_ctx *c, const void *src)                \
+{                                                                             \
+    return (PUSH);                                                            \
+}                                                                             \
+static size_t api##_pop(struct bench_ctx *c, void *dst)                       \
+{                                                                             \
+    return (POP);                                                             \
+}                                                                             \
+static void api##_st(struct bench_ctx *c, const void *src, void *dst)         \
+{                                                                             \
+    bench_run_st(c, api##_push, api##_pop, src, dst);                         \
+}                                                                             \
+static void api##_producer(struct bench_ctx *c, const void *src)              \
+{                                                                             \
+    bench_run_producer(c, api##_push, src);                                   \
+}                                                                             \
+static void api##_consumer(struct bench_ctx *c, void *dst)                    \
+{                                                                             \
+    bench_run_consumer(c, api##_pop, dst);                                    \
+}
+
+BENCH_DEFINE(ringbuf,
+        ringbuf_add_tail(&c->rb, src) == 0,
+        ringbuf_remove_head(&c->rb, dst) == 0)
+
+BENCH_DEFINE(ringbuf_n,
+        ringbuf_add_tail_n(&c->rb, src, BATCH),
+        ringbuf_remove_head_n(&c->rb, dst, BATCH))
+
+// build elements in place on the producer side, read the first byte of
+// each element in place on the consumer side
+static inline size_t zero_copy_fill(struct bench_ctx *c)
+{
+    size_t n;
+    void *p = ringbuf_reserve_tail_span(&c->rb, &n);
+
+    if (!p) {
+        return 0;
+    }
+    n = n < BATCH ? n : BATCH;
+    memset(p, (int)n, n * c->elem_sz);
+    ringbuf_commit_tail_n(&c->rb, n);
+    return n;
+}
+
+static inline size_t zero_copy_drain(struct bench_ctx *c)
+{
+    size_t n;
+    unsigned char *p = ringbuf_peek_head_span(&c->rb, &n);
+    unsigned sum = 0;
+
+    if (!p) {
+        return 0;
+    }
+    n = n < BATCH ? n : BATCH;
+    for (size_t i = 0; i < n; i++) {
+        sum += p[i * c->elem_sz];
+    }
+    c->sink += sum;
+    ringbuf_release_head_n(&c->rb, n);
+    return n;
+}
+
+BENCH_DEFINE(zero_copy, zero_copy_fill(c), zero_copy_drain(c))
+
+BENCH_DEFINE(mpmc,
+        ringbuf_mpmc_add_tail(&c->mpmc, src) == 0,
+        ringbuf_mpmc_remove_head(&c->mpmc, dst) == 0)
+
+#define BENCH_DEFINE_DECLARED(q, sz)                                          \
+BENCH_DEFINE(declared_##q,                                                    \
+        q##_add_tail(c->typed, (const struct bench_elem_##sz *)src) == 0,     \
+        q##_remove_head(c->typed, (struct bench_elem_##sz *)dst) == 0)
+
+BENCH_DEFINE_DECLARED(q1c, 1)
+BENCH_DEFINE_DECLARED(q8c, 8)
+BENCH_DEFINE_DECLARED(q64c, 64)
+BENCH_DEFINE_DECLARED(q1024c, 1024)
+BENCH_DEFINE_DECLARED(q1d, 1)
+BENCH_DEFINE_DECLARED(q8d, 8)
+BENCH_DEFINE_DECLARED(q64d, 64)
+BENCH_DEFINE_DECLARED(q1024d, 1024)
+
+static int ringbuf_setup(struct bench_ctx *c)
+{
+    return ringbuf_init(&c->rb, c->buf, c->n_elem, c->elem_sz);
+}
+
+static int mpmc_setup(struct bench_ctx *c)
+{
+    c->seq = malloc(c->n_elem * sizeof(*c->seq));
+    if (!c->seq) {
+        return -1;
+    }
+    return ringbuf_mpmc_init(&c->mpmc, c->buf, c->seq, c->n_elem, c->elem_sz);
+}
+
+#define DECLARED_SETUP(q)                                                     \
+static int q##_setup(struct bench_ctx *c)                                     \
+{                                                                             \
+    c->typed = aligned_alloc(RINGBUF_CACHELINE, sizeof(struct q));            \
+    if (!c->typed) {                                                          \
+        return -1;                                                            \
+    }                                                                         \
+    memset(c->typed, 0, sizeof(struct q));                                    \
+    q##_init(c->typed);                                                       \
+    return 0;                                                                 \
+}
+
+DECLARED_SETUP(q1c)
+DECLARED_SETUP(q8c)
+DECLARED_SETUP(q64c)
+DECLARED_SETUP(q1024c)
+DECLARED_SETUP(q1d)
+DECLARED_SETUP(q8d)
+DECLARED_SETUP(q64d)
+DECLARED_SETUP(q1024d)
+
+struct bench_api {
+    const char *name;
+    size_t batch;
+    /** only run for this element size / buffer size, if nonzero */
+    size_t elem_sz;
+    size_t buf_bytes;
+    int (*setup)(struct bench_ctx *c);
+    void (*st)(struct bench_ctx *c, const void *src, void *dst);
+    void (*producer)(struct bench_ctx *c, const void *src);
+    void (*consumer)(struct bench_ctx *c, void *dst);
+};
+
+#define API(name, batch, sz, bytes, setup, fn) \
+    { name, batch, sz, bytes, setup, fn##_st, fn##_producer, fn##_consumer }
+
+static const struct bench_api apis[] = {
+    API("ringbuf", 1, 0, 0, ringbuf_setup, ringbuf),
+    API("ringbuf_n", BATCH, 0, 0, ringbuf_setup, ringbuf_n),
+    API("zero_copy", BATCH, 0, 0, ringbuf_setup, zero_copy),
+    API("mpmc", 1, 0, 0, mpmc_setup, mpmc),
+    API("declared", 1, 1, CACHE_BYTES, q1c_setup, declared_q1c),
+    API("declared", 1, 8, CACHE_BYTES, q8c_setup, declared_q8c),
+    API("declared", 1, 64, CACHE_BYTES, q64c_setup, declared_q64c),
+    API("declared", 1, 1024, CACHE_BYTES, q1024c_setup, declared_q1024c),
+    API("declared", 1, 1, DRAM_BYTES, q1d_setup, declared_q1d),
+    API("declared", 1, 8, DRAM_BYTES, q8d_setup, declared_q8d),
+    API("declared", 1, 64, DRAM_BYTES, q64d_setup, declared_q64d),
+    API("declared", 1, 1024, DRAM_BYTES, q1024d_setup, declared_q1024d),
+};
+
+struct thread_arg {
+    const struct bench_api *api;
+    struct bench_ctx *c;
+    void *elems;
+};
+
+static void *producer_main(void *arg)
+{
+    struct thread_arg *t = arg;
+
+    t->api->producer(t->c, t->elems);
+    return NULL;
+}
+
+static void *consumer_main(void *arg)
+{
+    struct thread_arg *t = arg;
+
+    t->api->consumer(t->c, t->elems);
+    return NULL;
+}
+
+static int bench_one(const struct bench_api *api, size_t elem_sz, size_t buf_bytes,
+        int threads, size_t min_ops)
+{
+    struct bench_ctx *c;
+    void *src, *dst;
+    uint64_t t0, t1;
+    double secs;
+    int ret = -1;
+
+    c = calloc(1, sizeof(*c));
+    src = calloc(BATCH, elem_sz);
+    dst = calloc(BATCH, elem_sz);
+    if (!c || !src || !dst) {
+        goto out;
+    }
+
+    c->elem_sz = elem_sz;
+    c->n_elem = buf_bytes / elem_sz;
+    c->ops = min_ops > 2 * c->n_elem ? min_ops : 2 * c->n_elem;
+    c->buf = malloc(buf_bytes);
+    if (!c->buf) {
+        goto out;
+    }
+    memset(c->buf, 0, buf_bytes); // fault in pages before timing
+    if (api->setup(c) < 0) {
+        goto out;
+    }
+
+    if (threads == 1) {
+        t0 = now_ns();
+        api->st(c, src, dst);
+        t1 = now_ns();
+    } else {
+        struct thread_arg pa = { api, c, src }, ca = { api, c, dst };
+        pthread_t producer, consumer;
+
+        t0 = now_ns();
+        pthread_create(&consumer, NULL, consumer_main, &ca);
+        pthread_create(&producer, NULL, producer_main, &pa);
+        pthread_join(producer, NULL);
+        pthread_join(consumer, NULL);
+        t1 = now_ns();
+    }
+    secs = (t1 - t0) / 1e9;
+
+    qsort(c->push_lat.samples, c->push_lat.n, sizeof(uint64_t), cmp_u64);
+    qsort(c->pop_lat.samples, c->pop_lat.n, sizeof(uint64_t), cmp_u64);
+    printf("%s,%d,%zu,%zu,%zu,%zu,%.6f,%.3f,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            api->name, threads, elem_sz, c->n_elem, api->batch, c->ops, secs,
+            c->ops / secs / 1e6,
+            (unsigned long long)lat_pct(&c->push_lat, 0.50),
+            (unsigned long long)lat_pct(&c->push_lat, 0.99),
+            (unsigned long long)lat_pct(&c->push_lat, 0.999),
+            (unsigned long long)lat_pct(&c->pop_lat, 0.50),
+            (unsigned long long)lat_pct(&c->pop_lat, 0.99),
+            (unsigned long long)lat_pct(&c->pop_lat, 0.999));
+    fflush(stdout);
+    ret = 0;
+
+out:
+    if (c) {
+        free(c->typed);
+        free(c->seq);
+        free(c->buf);
+    }
+    free(c);
+    free(src);
+    free(dst);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    static const size_t elem_sizes[] = { 1, 8, 64, 1024 };
+    static const size_t buf_sizes[] = { CACHE_BYTES, DRAM_BYTES };
+    const char *only_api = NULL;
+    size_t min_ops = 1 << 22;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:a:")) != -1) {
+        switch (opt) {
+        case 'n':
+            min_ops = strtoull(optarg, NULL, 0);
+            break;
+        case 'a':
+            only_api = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n min_ops] [-a api]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_cpus < 1) {
+        n_cpus = 1;
+    }
+    calibrate_timer();
+    fprintf(stderr, "cpus=%ld timer_overhead_ns=%llu\n", n_cpus,
+            (unsigned long long)timer_overhead);
+
+    printf("api,threads,elem_sz,capacity,batch,ops,secs,mops,"
+            "push_p50_ns,push_p99_ns,push_p999_ns,pop_p50_ns,pop_p99_ns,pop_p999_ns\n");
+
+    for (size_t a = 0; a < sizeof(apis) / sizeof(apis[0]); a++) {
+        if (only_api && strcmp(only_api, apis[a].name)) {
+            continue;
+        }
+        for (int threads = 1; threads <= 2; threads++) {
+            for (size_t b = 0; b < sizeof(buf_sizes) / sizeof(buf_sizes[0]); b++) {
+                for (size_t e = 0; e < sizeof(elem_sizes) / sizeof(elem_sizes[0]); e++) {
+                    if ((apis[a].elem_sz && apis[a].elem_sz != elem_sizes[e]) ||
+                            (apis[a].buf_bytes && apis[a].buf_bytes != buf_sizes[b])) {
+                        continue;
+                    }
+                    if (bench_one(&apis[a], elem_sizes[e], buf_sizes[b], threads, min_ops) < 0) {
+                        fprintf(stderr, "%s: setup failed for elem_sz=%zu\n",
+                                apis[a].name, elem_sizes[e]);
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_fd.c readv/writev between file descriptors and a byte ringbuf.
+ */
+#include <errno.h>
+
+#include "ringbuf_fd.h"
+
+static int ringbuf_fd_spans_iov(const struct ringbuf_span spans[2], struct iovec iov[2])
+{
+    int cnt = 0;
+
+    for (int i = 0; i < 2; i++) {
+        if (spans[i].n) {
+            iov[cnt].iov_base = spans[i].ptr;
+            iov[cnt].iov_len = spans[i].n;
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+/**
+ * Builds an iovec covering the free space of a byte ringbuf. Producer side.
+ * @param iov set to the free spans, in order
+ * @return number of iov entries used (0 if the ringbuf is full), -1 with
+ * errno EINVAL if elem_sz is not 1
+ */
+int ringbuf_fd_tail_iov(struct ringbuf *rb, struct iovec iov[2])
+{
+    struct ringbuf_span spans[2];
+
+    if (rb->elem_sz != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    ringbuf_tail_spans(rb, spans);
+    return ringbuf_fd_spans_iov(spans, iov);
+}
+
+/**
+ * Builds an iovec covering the stored bytes of a byte ringbuf. Consumer side.
+ * @param iov set to the stored spans, in order
+ * @return number of iov entries used (0 if the ringbuf is empty), -1 with
+ * errno EINVAL if elem_sz is not 1
+ */
+int ringbuf_fd_head_iov(struct ringbuf *rb, struct iovec iov[2])
+{
+    struct ringbuf_span spans[2];
+
+    if (rb->elem_sz != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    ringbuf_head_spans(rb, spans);
+    return ringbuf_fd_spans_iov(spans, iov);
+}
+
+/**
+ * Reads from fd straight into the free space of a byte ringbuf, with one
+ * readv, and publishes what was read. Producer side.
+ * @return number of bytes read, 0 on end of file, -1 on error (errno set,
+ * ENOBUFS if the ringbuf is full)
+ */
+ssize_t ringbuf_fill_from_fd(struct ringbuf *rb, int fd)
+{
+    struct iovec iov[2];
+    ssize_t ret;
+    int cnt;
+
+    cnt = ringbuf_fd_tail_iov(rb, iov);
+    if (cnt <= 0) {
+        if (cnt == 0) {
+            errno = ENOBUFS;
+        }
+        return -1;
+    }
+    ret = readv(fd, iov, cnt);
+    if (ret > 0) {
+        ringbuf_commit_tail_n(rb, ret);
+    }
+    return ret;
+}
+
+/**
+ * Writes the stored bytes of a byte ringbuf straight to fd, with one
+ * writev, and releases what was written. Consumer side.
+ * @return number of bytes written (0 if the ringbuf is empty), -1 on error
+ * (errno set)
+ */
+ssize_t ringbuf_drain_to_fd(struct ringbuf *rb, int fd)
+{
+    struct iovec iov[2];
+    ssize_t ret;
+    int cnt;
+
+    cnt = ringbuf_fd_head_iov(rb, iov);
+    if (cnt <= 0) {
+        return cnt;
+    }
+    ret = writev(fd, iov, cnt);
+    if (ret > 0 && ringbuf_release_head_n(rb, ret) < 0) {
+        // RINGBUF_F_OVERWRITE: the producer overwrote what was being written
+        errno = ESTALE;
+        return -1;
+    }
+    return ret;
+}
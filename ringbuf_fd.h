@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_FD_H__
+#define __RINGBUF_FD_H__
+
+/**
+ * @file ringbuf_fd.h Moving data directly between file descriptors and the
+ * storage of a byte ringbuf (elem_sz == 1), without staging buffers.
+ *
+ * ringbuf_fill_from_fd and ringbuf_drain_to_fd build a one or two entry
+ * iovec from the free or stored spans and make a single readv/writev.
+ * For asynchronous I/O (e.g. an io_uring readv/writev), build the iovec
+ * with ringbuf_fd_tail_iov/ringbuf_fd_head_iov, submit it, and report the
+ * completed byte count with ringbuf_commit_tail_n/ringbuf_release_head_n.
+ * The iovec stays valid until then, as only the submitting side moves
+ * that end of the ringbuf.
+ */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "ringbuf.h"
+
+int ringbuf_fd_tail_iov(struct ringbuf *rb, struct iovec iov[2]);
+int ringbuf_fd_head_iov(struct ringbuf *rb, struct iovec iov[2]);
+ssize_t ringbuf_fill_from_fd(struct ringbuf *rb, int fd);
+ssize_t ringbuf_drain_to_fd(struct ringbuf *rb, int fd);
+
+#endif
@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_fd_test.c Example usage for moving data between file
+ * descriptors and a ringbuf.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ringbuf_fd.h"
+
+#define RING_BYTES 64
+
+// pipe -> ringbuf -> pipe with odd chunk sizes, so that readv and writev
+// keep getting split at the wrap point
+static void test_fd_pipes(void)
+{
+    char buf[RING_BYTES], in[4096], out[4096];
+    struct ringbuf rb;
+    struct iovec iov[2];
+    int src[2], dst[2];
+    size_t sent = 0, got = 0;
+    ssize_t n;
+    int cnt;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    for (size_t i = 0; i < sizeof(in); i++) {
+        in[i] = (char)(i * 31 + 7);
+    }
+    assert(0 == pipe(src) && 0 == pipe(dst));
+    assert(0 == fcntl(src[0], F_SETFL, O_NONBLOCK));
+    assert(0 == ringbuf_init(&rb, buf, RING_BYTES, 1));
+
+    assert(0 == ringbuf_drain_to_fd(&rb, dst[1])); // empty
+
+    while (got < sizeof(in)) {
+        size_t chunk = sizeof(in) - sent < 37 ? sizeof(in) - sent : 37;
+
+        if (chunk) {
+            assert((ssize_t)chunk == write(src[1], in + sent, chunk));
+            sent += chunk;
+        }
+        n = ringbuf_fill_from_fd(&rb, src[0]);
+        assert(n > 0 || (n < 0 && (errno == ENOBUFS || errno == EAGAIN)));
+        n = ringbuf_drain_to_fd(&rb, dst[1]);
+        assert(n >= 0);
+        assert(n == read(dst[0], out + got, n));
+        got += n;
+    }
+    assert(0 == memcmp(in, out, sizeof(in)));
+    assert(ringbuf_empty(&rb));
+
+    // a full ringbuf refuses to read
+    assert(RING_BYTES == write(src[1], in, RING_BYTES));
+    assert(RING_BYTES == ringbuf_fill_from_fd(&rb, src[0]));
+    assert(1 == write(src[1], in, 1));
+    assert(-1 == ringbuf_fill_from_fd(&rb, src[0]) && errno == ENOBUFS);
+    assert(0 == ringbuf_fd_tail_iov(&rb, iov));
+
+    // the async path: build the iovec, do the I/O elsewhere, then commit
+    assert(0 == ringbuf_release_head_n(&rb, 10));
+    cnt = ringbuf_fd_tail_iov(&rb, iov);
+    assert(cnt == 1 || cnt == 2);
+    assert(10 == iov[0].iov_len + (cnt == 2 ? iov[1].iov_len : 0));
+    assert(1 == readv(src[0], iov, cnt));
+    assert(0 == ringbuf_commit_tail_n(&rb, 1));
+    assert(RING_BYTES - 9 == ringbuf_count(&rb));
+
+    // end of file
+    close(src[1]);
+    assert(0 == ringbuf_fill_from_fd(&rb, src[0]));
+
+    close(src[0]);
+    close(dst[0]);
+    close(dst[1]);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_fd_elem_size(void)
+{
+    int buf[8];
+    struct ringbuf rb;
+    struct iovec iov[2];
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_init(&rb, buf, 8, sizeof(int)));
+    assert(-1 == ringbuf_fd_tail_iov(&rb, iov) && errno == EINVAL);
+    assert(-1 == ringbuf_fill_from_fd(&rb, 0) && errno == EINVAL);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_fd_pipes();
+    test_fd_elem_size();
+
+    return 0;
+}
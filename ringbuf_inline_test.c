@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_inline_test.c Example usage for the RINGBUF_INLINE build
+ * of the core operations.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#define RINGBUF_INLINE 1
+#include "ringbuf.h"
+
+#define ELEMS_BUF_LEN 8
+#define N_ITEMS 100000
+
+static int copy_calls;
+
+static void copy_int(void *dst, const void *src)
+{
+    *(int *)dst = *(const int *)src;
+    copy_calls++;
+}
+
+static void test_inline_basic(size_t cap, unsigned flags)
+{
+    int buf[ELEMS_BUF_LEN], my_elem;
+    struct ringbuf_stats st;
+    struct ringbuf rb;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_init_flags(&rb, buf, cap, sizeof(int), flags));
+    assert(ringbuf_empty(&rb) && !ringbuf_full(&rb));
+    assert(-1 == ringbuf_remove_head(&rb, &my_elem));
+    assert(0 == ringbuf_add_tail(&rb, NULL));
+
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < (int)cap; i++) {
+            assert(0 == ringbuf_add_tail(&rb, &i));
+            assert((size_t)i + 1 == ringbuf_count(&rb));
+        }
+        assert(ringbuf_full(&rb));
+        assert(-1 == ringbuf_add_tail(&rb, &my_elem));
+        for (int i = 0; i < (int)cap; i++) {
+            assert(0 == ringbuf_remove_head(&rb, &my_elem) && my_elem == i);
+        }
+        assert(-1 == ringbuf_remove_head(&rb, NULL));
+        // odd step so the indices take every value
+        assert(0 == ringbuf_add_tail(&rb, &round) && 0 == ringbuf_remove_head(&rb, NULL));
+    }
+
+    ringbuf_stats_snapshot(&rb, &st);
+#if RINGBUF_STATS
+    // same counts as the library functions
+    assert(st.enqueued == 5 * (cap + 1) && st.dequeued == 5 * (cap + 1));
+    assert(st.full == 5 && st.empty == 6 && st.high_water == cap);
+#endif
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_inline_fallback(void)
+{
+    int buf[ELEMS_BUF_LEN], my_elem;
+    struct ringbuf rb;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    // callbacks go through the library
+    assert(0 == ringbuf_init(&rb, buf, ELEMS_BUF_LEN, sizeof(int)));
+    rb.ops.elem_copy = copy_int;
+    my_elem = 5;
+    assert(0 == ringbuf_add_tail(&rb, &my_elem));
+    assert(0 == ringbuf_remove_head(&rb, &my_elem) && 5 == my_elem);
+    assert(2 == copy_calls);
+
+    // so do the flags with extra work on the hot path
+    assert(0 == ringbuf_init_flags(&rb, buf, ELEMS_BUF_LEN, sizeof(int), RINGBUF_F_OVERWRITE));
+    for (int i = 0; i < ELEMS_BUF_LEN + 3; i++) {
+        assert(0 == ringbuf_add_tail(&rb, &i));
+    }
+    assert(3 == ringbuf_dropped(&rb) && ringbuf_full(&rb));
+    assert(0 == ringbuf_remove_head(&rb, &my_elem) && 3 == my_elem);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static struct ringbuf spsc_rb;
+
+static void *inline_consumer(void *arg)
+{
+    int my_elem;
+
+    for (int i = 0; i < N_ITEMS; i++) {
+        while (ringbuf_remove_head(&spsc_rb, &my_elem) < 0) {
+            sched_yield();
+        }
+        assert(my_elem == i);
+    }
+    return NULL;
+}
+
+static void test_inline_spsc_threads(void)
+{
+    int buf[ELEMS_BUF_LEN];
+    pthread_t consumer;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_init(&spsc_rb, buf, ELEMS_BUF_LEN - 1, sizeof(int)));
+    assert(0 == pthread_create(&consumer, NULL, inline_consumer, NULL));
+    for (int i = 0; i < N_ITEMS; i++) {
+        while (ringbuf_add_tail(&spsc_rb, &i) < 0) {
+            sched_yield();
+        }
+    }
+    assert(0 == pthread_join(consumer, NULL));
+    assert(ringbuf_empty(&spsc_rb));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_inline_basic(ELEMS_BUF_LEN, RINGBUF_F_POW2);
+    test_inline_basic(ELEMS_BUF_LEN - 1, 0);
+    test_inline_basic(ELEMS_BUF_LEN, RINGBUF_F_POW2 | RINGBUF_F_NT);
+    test_inline_fallback();
+    test_inline_spsc_threads();
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_mpmc.c Lock-free multi-producer/multi-consumer ringbuf.
+ *
+ * Each slot carries a sequence number. A slot at position pos is free for
+ * the producer claiming pos when seq == pos, and holds an element for the
+ * consumer claiming pos when seq == pos + 1. The consumer then sets it to
+ * pos + capacity, making it free for the producer one lap later.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "ringbuf_mpmc.h"
+
+/**
+ * Initialize a ringbuf_mpmc struct.
+ *
+ * Same external storage model as ringbuf_init: buf must hold n_elem
+ * elements of elem_sz bytes. In addition, seq must point to an array of
+ * n_elem atomic_size_t used for the per-slot sequence numbers. No memory
+ * allocation is performed.
+ *
+ * @param rb pointer to the ringbuf_mpmc struct to initialize
+ * @param buf pointer to the array buffer
+ * @param seq pointer to the sequence number array
+ * @param n_elem maximum number of elements buf can hold, must be a power of
+ * two and at least 2 (with one slot, a filled slot's sequence number equals
+ * the next producer position, so it would look free again)
+ * @param elem_sz the size (bytes) of each element
+ * @return 0 on success, -1 if rb, buf or seq are NULL or n_elem is not a
+ * power of two of at least 2
+ */
+int ringbuf_mpmc_init(struct ringbuf_mpmc *rb, const void *buf, atomic_size_t *seq,
+        size_t n_elem, size_t elem_sz)
+{
+    if (!rb || !buf || !seq) {
+        return -1;
+    }
+    if (n_elem < 2 || (n_elem & (n_elem - 1))) {
+        return -1;
+    }
+
+    rb->buf = buf;
+    rb->seq = seq;
+    rb->capacity = n_elem;
+    rb->mask = n_elem - 1;
+    rb->elem_sz = elem_sz;
+    rb->ops.elem_copy = NULL;
+    for (size_t i = 0; i < n_elem; i++) {
+        atomic_init(&seq[i], i);
+    }
+    atomic_init(&rb->tail, 0);
+    atomic_init(&rb->head, 0);
+
+    return 0;
+}
+
+/**
+ * Returns the number of elements currently stored, including slots
+ * that have been claimed but not yet completed.
+ *
+ * Only a snapshot when called concurrently with producers or consumers.
+ */
+size_t ringbuf_mpmc_count(const struct ringbuf_mpmc *rb)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+    // head may be read ahead of a racing producer's tail
+    return (intptr_t)(tail - head) > 0 ? tail - head : 0;
+}
+
+/**
+ * Adds an element to the tail of the ringbuf. Safe to call from any thread.
+ * @param elem element to add. If NULL, the ringbuf is not modified and 0 is returned.
+ * @return 0 on success, -1 if ringbuf is full
+ */
+int ringbuf_mpmc_add_tail(struct ringbuf_mpmc *rb, const void *elem)
+{
+    size_t pos, seq;
+    intptr_t diff;
+    void *tp;
+
+    if (!elem) {
+        return 0;
+    }
+
+    pos = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    for (;;) {
+        seq = atomic_load_explicit(&rb->seq[pos & rb->mask], memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            // slot is free for this lap, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&rb->tail, &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // slot still holds the element from the previous lap
+            return -1;
+        } else {
+            // another producer got here first
+            pos = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+        }
+    }
+
+    tp = (char *)rb->buf + rb->elem_sz * (pos & rb->mask);
+    if (rb->ops.elem_copy) {
+        (*rb->ops.elem_copy)(tp, elem);
+    } else {
+        memcpy(tp, elem, rb->elem_sz);
+    }
+
+    // publish the element to the consumer claiming pos
+    atomic_store_explicit(&rb->seq[pos & rb->mask], pos + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Removes an element from the head of the ringbuf. Safe to call from any thread.
+ * @param elem where to copy the removed element. If NULL, the element is simply removed.
+ * @return 0 on success, -1 if ringbuf is empty
+ */
+int ringbuf_mpmc_remove_head(struct ringbuf_mpmc *rb, void *elem)
+{
+    size_t pos, seq;
+    intptr_t diff;
+    void *hp;
+
+    pos = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    for (;;) {
+        seq = atomic_load_explicit(&rb->seq[pos & rb->mask], memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            // slot holds an element for this lap, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&rb->head, &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // producer has not filled this slot yet
+            return -1;
+        } else {
+            // another consumer got here first
+            pos = atomic_load_explicit(&rb->head, memory_order_relaxed);
+        }
+    }
+
+    hp = (char *)rb->buf + rb->elem_sz * (pos & rb->mask);
+    if (elem) {
+        if (rb->ops.elem_copy) {
+            (*rb->ops.elem_copy)(elem, hp);
+        } else {
+            memcpy(elem, hp, rb->elem_sz);
+        }
+    }
+
+    // hand the slot back to the producer claiming pos + capacity
+    atomic_store_explicit(&rb->seq[pos & rb->mask], pos + rb->capacity, memory_order_release);
+    return 0;
+}
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_MPMC_H__
+#define __RINGBUF_MPMC_H__
+
+/**
+ * @file ringbuf_mpmc.h Lock-free multi-producer/multi-consumer variant of
+ * the ringbuf, using per-slot sequence numbers.
+ */
+
+#include "ringbuf.h"
+
+/**
+ * Multi-producer/multi-consumer ringbuf.
+ *
+ * Any number of threads may call ringbuf_mpmc_add_tail and
+ * ringbuf_mpmc_remove_head concurrently. Producers and consumers claim a
+ * slot with a CAS on their respective position and then hand it over
+ * through the slot's sequence number, so there is no global lock and a
+ * slow thread only holds up the slot it claimed.
+ */
+struct ringbuf_mpmc {
+    /** Base pointer of element array */
+    const void *buf;
+    /** Per-slot sequence numbers, n_elem entries */
+    atomic_size_t *seq;
+    /** Maximum number of elements that can be stored, a power of two */
+    size_t capacity;
+    /** capacity - 1 */
+    size_t mask;
+    /** Size of each element (bytes) */
+    size_t elem_sz;
+
+    /** Function pointers (callbacks) for custom operations */
+    struct {
+        /**
+         * Optional user provided function that implements copying an element from src
+         * to dst. If not set, memcpy is used by default.
+         */
+        void (*elem_copy)(void *dst, const void *src);
+    } ops;
+
+    /** Next position to be claimed by a producer */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t tail;
+    /** Next position to be claimed by a consumer */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t head;
+};
+
+int ringbuf_mpmc_init(struct ringbuf_mpmc *rb, const void *buf, atomic_size_t *seq,
+        size_t n_elem, size_t elem_sz);
+size_t ringbuf_mpmc_count(const struct ringbuf_mpmc *rb);
+int ringbuf_mpmc_add_tail(struct ringbuf_mpmc *rb, const void *elem);
+int ringbuf_mpmc_remove_head(struct ringbuf_mpmc *rb, void *elem);
+
+#endif
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_mpmc_test.c Example usage for the multi-producer/multi-consumer ringbuf.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ringbuf_mpmc.h"
+
+#define ELEMS_BUF_LEN 8
+
+#define N_PRODUCERS 4
+#define N_CONSUMERS 4
+#define N_ITEMS_PER_PRODUCER 50000
+
+struct my_item {
+    int producer;
+    int seq;
+};
+
+static void test_mpmc_basic(void)
+{
+    int buf[ELEMS_BUF_LEN];
+    atomic_size_t seq[ELEMS_BUF_LEN];
+    struct ringbuf_mpmc rb;
+    int my_elem;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_mpmc_init(&rb, buf, seq, ELEMS_BUF_LEN - 1, sizeof(buf[0])));
+    assert(-1 == ringbuf_mpmc_init(&rb, buf, seq, 1, sizeof(buf[0])));
+    assert(-1 == ringbuf_mpmc_init(&rb, buf, seq, 0, sizeof(buf[0])));
+    assert(-1 == ringbuf_mpmc_init(&rb, buf, NULL, ELEMS_BUF_LEN, sizeof(buf[0])));
+    assert(0 == ringbuf_mpmc_init(&rb, buf, seq, ELEMS_BUF_LEN, sizeof(buf[0])));
+
+    assert(-1 == ringbuf_mpmc_remove_head(&rb, &my_elem)); // empty
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == ringbuf_mpmc_add_tail(&rb, &i));
+        }
+        assert(-1 == ringbuf_mpmc_add_tail(&rb, &my_elem)); // full
+        assert(ELEMS_BUF_LEN == ringbuf_mpmc_count(&rb));
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == ringbuf_mpmc_remove_head(&rb, &my_elem));
+            assert(my_elem == i);
+        }
+        assert(-1 == ringbuf_mpmc_remove_head(&rb, &my_elem)); // empty
+        assert(0 == ringbuf_mpmc_count(&rb));
+    }
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static struct ringbuf_mpmc shared_rb;
+static atomic_int n_consumed;
+
+static void *mpmc_producer(void *arg)
+{
+    struct my_item item = { .producer = (int)(size_t)arg };
+
+    for (item.seq = 0; item.seq < N_ITEMS_PER_PRODUCER; item.seq++) {
+        while (ringbuf_mpmc_add_tail(&shared_rb, &item) < 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+    int last_seq[N_PRODUCERS];
+    struct my_item item;
+
+    memset(last_seq, -1, sizeof(last_seq));
+
+    while (atomic_load(&n_consumed) < N_PRODUCERS * N_ITEMS_PER_PRODUCER) {
+        if (ringbuf_mpmc_remove_head(&shared_rb, &item) < 0) {
+            sched_yield();
+            continue;
+        }
+        // items from any one producer are seen in order
+        assert(item.producer >= 0 && item.producer < N_PRODUCERS);
+        assert(item.seq > last_seq[item.producer]);
+        last_seq[item.producer] = item.seq;
+        atomic_fetch_add(&n_consumed, 1);
+    }
+    return NULL;
+}
+
+static void test_mpmc_threads(void)
+{
+    struct my_item buf[ELEMS_BUF_LEN * 4];
+    atomic_size_t seq[ELEMS_BUF_LEN * 4];
+    pthread_t producers[N_PRODUCERS], consumers[N_CONSUMERS];
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_mpmc_init(&shared_rb, buf, seq, ELEMS_BUF_LEN * 4, sizeof(buf[0])));
+    atomic_store(&n_consumed, 0);
+
+    for (size_t i = 0; i < N_CONSUMERS; i++) {
+        assert(0 == pthread_create(&consumers[i], NULL, mpmc_consumer, NULL));
+    }
+    for (size_t i = 0; i < N_PRODUCERS; i++) {
+        assert(0 == pthread_create(&producers[i], NULL, mpmc_producer, (void *)i));
+    }
+    for (size_t i = 0; i < N_PRODUCERS; i++) {
+        assert(0 == pthread_join(producers[i], NULL));
+    }
+    for (size_t i = 0; i < N_CONSUMERS; i++) {
+        assert(0 == pthread_join(consumers[i], NULL));
+    }
+
+    assert(N_PRODUCERS * N_ITEMS_PER_PRODUCER == atomic_load(&n_consumed));
+    assert(0 == ringbuf_mpmc_count(&shared_rb));
+    printf("consumed %d items\n", atomic_load(&n_consumed));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_mpmc_basic();
+    test_mpmc_threads();
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_numa.c NUMA aware ringbuf placement and thread pinning.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "ringbuf_numa.h"
+
+#define RINGBUF_NUMA_HUGE_SZ (2ul << 20)
+
+// Control block at the start of the mapping, storage right after it
+struct ringbuf_numa {
+    struct ringbuf rb;
+    size_t map_sz;
+};
+
+#define RINGBUF_NUMA_DATA_OFF \
+    ((sizeof(struct ringbuf_numa) + RINGBUF_CACHELINE - 1) & ~(size_t)(RINGBUF_CACHELINE - 1))
+
+#ifdef __linux__
+static void *ringbuf_numa_map(size_t *sz, unsigned numa_flags)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    void *addr;
+
+    if (numa_flags & RINGBUF_NUMA_HUGE) {
+        *sz = (*sz + RINGBUF_NUMA_HUGE_SZ - 1) & ~(RINGBUF_NUMA_HUGE_SZ - 1);
+        addr = mmap(NULL, *sz, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+            return addr;
+        }
+    } else {
+        *sz = (*sz + page - 1) & ~(page - 1);
+    }
+    addr = mmap(NULL, *sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    if (numa_flags & RINGBUF_NUMA_HUGE) {
+        // best effort, THP may be disabled
+        madvise(addr, *sz, MADV_HUGEPAGE);
+    }
+    return addr;
+}
+#endif
+
+/**
+ * Creates a ringbuf whose control block and storage live on a NUMA node.
+ *
+ * Both come from one anonymous mapping that is bound to node before any
+ * page is touched, then faulted in completely, so later pushes and pops
+ * never take page faults or allocate on another node.
+ *
+ * @param n_elem maximum number of elements
+ * @param elem_sz the size (bytes) of each element
+ * @param flags RINGBUF_F_* flags for ringbuf_init_flags, RINGBUF_F_POW2 is
+ * detected automatically
+ * @param node NUMA node, negative for the node of the calling CPU
+ * @param numa_flags RINGBUF_NUMA_* flags
+ * @return the new ringbuf, free it with ringbuf_numa_destroy. NULL on
+ * failure, or with RINGBUF_NUMA_STRICT if the memory could not be bound.
+ */
+struct ringbuf *ringbuf_numa_create(size_t n_elem, size_t elem_sz, unsigned flags, int node,
+        unsigned numa_flags)
+{
+#ifdef __linux__
+    unsigned long mask[RINGBUF_NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    struct ringbuf_numa *rn;
+    size_t sz;
+    long ret;
+
+    if (!n_elem || !elem_sz || n_elem > (SIZE_MAX - RINGBUF_NUMA_DATA_OFF) / 2 / elem_sz) {
+        return NULL;
+    }
+    if (node < 0) {
+        node = ringbuf_numa_current_node();
+        if (node < 0) {
+            node = 0;
+        }
+    }
+    if (node >= RINGBUF_NUMA_MAX_NODES) {
+        return NULL;
+    }
+    if (!(n_elem & (n_elem - 1))) {
+        flags |= RINGBUF_F_POW2;
+    }
+
+    sz = RINGBUF_NUMA_DATA_OFF + n_elem * elem_sz;
+    rn = ringbuf_numa_map(&sz, numa_flags);
+    if (!rn) {
+        return NULL;
+    }
+
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    // the kernel reads maxnode - 1 bits
+    ret = syscall(SYS_mbind, rn, sz, (numa_flags & RINGBUF_NUMA_STRICT) ? MPOL_BIND : MPOL_PREFERRED,
+            mask, (unsigned long)RINGBUF_NUMA_MAX_NODES + 1, 0);
+    if (ret < 0 && (numa_flags & RINGBUF_NUMA_STRICT)) {
+        munmap(rn, sz);
+        return NULL;
+    }
+    // fault everything in now, on the node
+    memset(rn, 0, sz);
+
+    if (ringbuf_init_flags(&rn->rb, (char *)rn + RINGBUF_NUMA_DATA_OFF, n_elem, elem_sz,
+                flags) < 0) {
+        munmap(rn, sz);
+        return NULL;
+    }
+    rn->map_sz = sz;
+    return &rn->rb;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Releases a ringbuf created by ringbuf_numa_create.
+ */
+void ringbuf_numa_destroy(struct ringbuf *rb)
+{
+#ifdef __linux__
+    struct ringbuf_numa *rn = (struct ringbuf_numa *)rb;
+
+    if (rb) {
+        munmap(rn, rn->map_sz);
+    }
+#endif
+}
+
+/**
+ * Returns the NUMA node holding the page at addr, -1 if unknown (e.g. the
+ * page has not been faulted in yet).
+ */
+int ringbuf_numa_node_of(const void *addr)
+{
+#ifdef __linux__
+    int node = -1;
+
+    if (syscall(SYS_get_mempolicy, &node, NULL, 0ul, addr, MPOL_F_NODE | MPOL_F_ADDR) < 0) {
+        return -1;
+    }
+    return node;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Returns the NUMA node holding the ringbuf's element storage, -1 if unknown.
+ * Works for any ringbuf, not just ones from ringbuf_numa_create.
+ */
+int ringbuf_numa_node(const struct ringbuf *rb)
+{
+    return ringbuf_numa_node_of(rb->buf);
+}
+
+/**
+ * Returns the NUMA node of the CPU the calling thread is running on, -1 if
+ * unknown.
+ */
+int ringbuf_numa_current_node(void)
+{
+#ifdef __linux__
+    unsigned cpu, node;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) < 0) {
+        return -1;
+    }
+    return (int)node;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Lists the CPUs of a NUMA node.
+ * @param cpus filled in with up to max_cpus CPU numbers
+ * @param max_cpus size of cpus
+ * @return number of CPUs on the node (may exceed max_cpus), -1 on failure
+ */
+int ringbuf_numa_node_cpus(int node, int *cpus, int max_cpus)
+{
+    char path[64], list[4096], *p, *end;
+    int n = 0;
+    FILE *f;
+
+    if (node < 0) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    if (!fgets(list, sizeof(list), f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    // e.g. "0-3,8-11\n"
+    for (p = list; *p && *p != '\n'; p = end) {
+        long lo, hi;
+
+        if (*p == ',') {
+            end = p + 1;
+            continue;
+        }
+        lo = hi = strtol(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p) {
+                return -1;
+            }
+        }
+        for (long cpu = lo; cpu <= hi; cpu++, n++) {
+            if (n < max_cpus) {
+                cpus[n] = (int)cpu;
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * Pins the calling thread to the CPUs of a NUMA node, e.g. the consumer to
+ * ringbuf_numa_node(rb).
+ * @return 0 on success, -1 on failure
+ */
+int ringbuf_numa_pin(int node)
+{
+    int cpus[CPU_SETSIZE];
+    cpu_set_t set;
+    int n;
+
+    n = ringbuf_numa_node_cpus(node, cpus, CPU_SETSIZE);
+    if (n <= 0) {
+        return -1;
+    }
+    CPU_ZERO(&set);
+    for (int i = 0; i < n && i < CPU_SETSIZE; i++) {
+        CPU_SET(cpus[i], &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ? -1 : 0;
+}
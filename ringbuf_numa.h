@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_NUMA_H__
+#define __RINGBUF_NUMA_H__
+
+/**
+ * @file ringbuf_numa.h NUMA aware ringbuf placement and thread pinning.
+ *
+ * ringbuf_numa_create allocates the control block and the element storage
+ * together in one mapping bound to a NUMA node, and faults it in there
+ * up front. The placement helpers then let a scheduler pin the consumer
+ * (which reads every element) onto the node that holds it. Linux only;
+ * uses the mbind/get_mempolicy system calls directly, so no libnuma needed.
+ */
+
+#include "ringbuf.h"
+
+/** ringbuf_numa_create() flags */
+/** Fail if memory cannot be bound to the node, instead of preferring it */
+#define RINGBUF_NUMA_STRICT (1u << 0)
+/**
+ * Back the ringbuf with 2 MB huge pages. Uses reserved hugetlb pages when
+ * there are any, otherwise asks for transparent huge pages.
+ */
+#define RINGBUF_NUMA_HUGE   (1u << 1)
+
+/** Highest NUMA node number supported + 1 */
+#define RINGBUF_NUMA_MAX_NODES 1024
+
+struct ringbuf *ringbuf_numa_create(size_t n_elem, size_t elem_sz, unsigned flags, int node,
+        unsigned numa_flags);
+void ringbuf_numa_destroy(struct ringbuf *rb);
+int ringbuf_numa_node(const struct ringbuf *rb);
+int ringbuf_numa_node_of(const void *addr);
+int ringbuf_numa_current_node(void);
+int ringbuf_numa_node_cpus(int node, int *cpus, int max_cpus);
+int ringbuf_numa_pin(int node);
+
+#endif
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_numa_test.c Example usage for NUMA ringbuf placement.
+ */
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ringbuf_numa.h"
+
+#define ELEMS_BUF_LEN 8
+
+static void test_numa_create(void)
+{
+    struct ringbuf *rb;
+    int node, my_elem;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(NULL == ringbuf_numa_create(0, sizeof(int), 0, 0, 0));
+    assert(NULL == ringbuf_numa_create(ELEMS_BUF_LEN, sizeof(int), 0, RINGBUF_NUMA_MAX_NODES, 0));
+
+    rb = ringbuf_numa_create(ELEMS_BUF_LEN, sizeof(int), 0, 0, RINGBUF_NUMA_STRICT);
+    assert(rb);
+    assert(0 == (size_t)rb % RINGBUF_CACHELINE);
+    assert(rb->flags & RINGBUF_F_POW2);
+    node = ringbuf_numa_node(rb);
+    printf("storage on node %d, control block on node %d\n", node, ringbuf_numa_node_of(rb));
+    assert(0 == node && 0 == ringbuf_numa_node_of(rb));
+
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == ringbuf_add_tail(rb, &i));
+    }
+    assert(-1 == ringbuf_add_tail(rb, &my_elem));
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == ringbuf_remove_head(rb, &my_elem) && my_elem == i);
+    }
+    ringbuf_numa_destroy(rb);
+
+    // local node, huge pages (falls back to THP when none are reserved)
+    rb = ringbuf_numa_create(1000, 64, 0, -1, RINGBUF_NUMA_HUGE);
+    assert(rb);
+    assert(!(rb->flags & RINGBUF_F_POW2));
+    assert(ringbuf_numa_node(rb) == ringbuf_numa_current_node());
+    assert(0 == ringbuf_add_tail(rb, &(char[64]){ 1 }));
+    assert(1 == ringbuf_count(rb));
+    ringbuf_numa_destroy(rb);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_numa_pin(void)
+{
+    int cpus[256], n;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    n = ringbuf_numa_node_cpus(0, cpus, 256);
+    assert(n > 0);
+    printf("node 0: %d cpus, first %d\n", n, cpus[0]);
+    assert(-1 == ringbuf_numa_node_cpus(-1, cpus, 256));
+    assert(-1 == ringbuf_numa_node_cpus(RINGBUF_NUMA_MAX_NODES, cpus, 256));
+
+    assert(0 == ringbuf_numa_pin(0));
+    sched_yield();
+    assert(0 == ringbuf_numa_current_node());
+    assert(-1 == ringbuf_numa_pin(RINGBUF_NUMA_MAX_NODES));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_numa_create();
+    test_numa_pin();
+
+    return 0;
+}
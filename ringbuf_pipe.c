@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_pipe.c Staged pipeline ringbuf.
+ *
+ * Positions run freely and are masked on access, as with RINGBUF_F_POW2.
+ * Stage s > 0 may claim up to the position of stage s - 1, and stage 0 up
+ * to the position of the last stage plus capacity, so a slot is only
+ * reused once every stage has published it.
+ */
+#include "ringbuf_pipe.h"
+
+// the position stage may claim up to, as published by its upstream stage
+static size_t ringbuf_pipe_limit(const struct ringbuf_pipe *p, size_t stage)
+{
+    if (stage == 0) {
+        // acquire: the last stage is done with slots before its position
+        return atomic_load_explicit(&p->stages[p->n_stages - 1].pos, memory_order_acquire) +
+                p->capacity;
+    }
+    // acquire: pairs with the upstream stage's release of its position
+    return atomic_load_explicit(&p->stages[stage - 1].pos, memory_order_acquire);
+}
+
+// elements stage may claim, refreshing the cached limit only when needed
+static size_t ringbuf_pipe_avail(struct ringbuf_pipe *p, struct ringbuf_pipe_stage *st,
+        size_t pos, size_t want)
+{
+    if (st->limit_cache - pos < want) {
+        st->limit_cache = ringbuf_pipe_limit(p, st - p->stages);
+    }
+    return st->limit_cache - pos;
+}
+
+/**
+ * Initialize a ringbuf_pipe struct.
+ *
+ * Same external storage model as ringbuf_init: buf must hold n_elem
+ * elements of elem_sz bytes, and stages must point to n_stages stage
+ * structs. No memory allocation is performed.
+ *
+ * @param p pointer to the ringbuf_pipe struct to initialize
+ * @param buf pointer to the array buffer
+ * @param stages pointer to the stage state array
+ * @param n_stages number of stages including the producer, at least 2
+ * @param n_elem maximum number of elements in flight, must be a power of two
+ * @param elem_sz the size (bytes) of each element
+ * @return 0 on success, -1 on invalid arguments
+ */
+int ringbuf_pipe_init(struct ringbuf_pipe *p, void *buf, struct ringbuf_pipe_stage *stages,
+        size_t n_stages, size_t n_elem, size_t elem_sz)
+{
+    if (!p || !buf || !stages || n_stages < 2) {
+        return -1;
+    }
+    if (!n_elem || (n_elem & (n_elem - 1))) {
+        return -1;
+    }
+
+    p->buf = buf;
+    p->stages = stages;
+    p->n_stages = n_stages;
+    p->capacity = n_elem;
+    p->mask = n_elem - 1;
+    p->elem_sz = elem_sz;
+    for (size_t i = 0; i < n_stages; i++) {
+        atomic_init(&stages[i].pos, 0);
+        stages[i].limit_cache = i == 0 ? n_elem : 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the number of elements stage may claim (free slots for stage 0).
+ *
+ * Only a snapshot when called concurrently with the stages.
+ */
+size_t ringbuf_pipe_count(const struct ringbuf_pipe *p, size_t stage)
+{
+    size_t pos = atomic_load_explicit(&p->stages[stage].pos, memory_order_acquire);
+
+    return ringbuf_pipe_limit(p, stage) - pos;
+}
+
+/**
+ * Claims a batch of up to max slots for in-place processing by stage.
+ *
+ * The slots are the next ones after the last publish of stage, and stay
+ * owned by it until published with ringbuf_pipe_publish. Claiming again
+ * without publishing returns the same slots (and possibly more).
+ * @param spans set to the claimed slots, spans[1].n is 0 if there is no wrap
+ * @return number of slots claimed (spans[0].n + spans[1].n), 0 if none are
+ * ready for stage
+ */
+size_t ringbuf_pipe_claim(struct ringbuf_pipe *p, size_t stage, size_t max,
+        struct ringbuf_span spans[2])
+{
+    struct ringbuf_pipe_stage *st = &p->stages[stage];
+    size_t pos = atomic_load_explicit(&st->pos, memory_order_relaxed);
+    size_t slot = pos & p->mask;
+    size_t n = ringbuf_pipe_avail(p, st, pos, max);
+    size_t run;
+
+    if (n > max) {
+        n = max;
+    }
+    run = p->capacity - slot < n ? p->capacity - slot : n;
+    spans[0].ptr = (char *)p->buf + p->elem_sz * slot;
+    spans[0].n = run;
+    spans[1].ptr = p->buf;
+    spans[1].n = n - run;
+    return n;
+}
+
+/**
+ * Claims the contiguous run of ready slots for stage, up to the wrap point.
+ * @param n set to the number of contiguous slots (0 if none are ready)
+ * @return pointer to the first slot, NULL if none are ready
+ */
+void *ringbuf_pipe_claim_span(struct ringbuf_pipe *p, size_t stage, size_t *n)
+{
+    struct ringbuf_span spans[2];
+
+    ringbuf_pipe_claim(p, stage, p->capacity, spans);
+    *n = spans[0].n;
+    return spans[0].n ? spans[0].ptr : NULL;
+}
+
+/**
+ * Publishes the first n slots claimed by stage to the next stage (or,
+ * from the last stage, back to stage 0 as free slots).
+ * @return 0 on success, -1 if fewer than n slots are ready for stage
+ */
+int ringbuf_pipe_publish(struct ringbuf_pipe *p, size_t stage, size_t n)
+{
+    struct ringbuf_pipe_stage *st = &p->stages[stage];
+    size_t pos = atomic_load_explicit(&st->pos, memory_order_relaxed);
+
+    if (n > ringbuf_pipe_avail(p, st, pos, n)) {
+        return -1;
+    }
+    // release: the stage's writes to the slots happen before the next stage claims them
+    atomic_store_explicit(&st->pos, pos + n, memory_order_release);
+    return 0;
+}
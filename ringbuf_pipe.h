@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_PIPE_H__
+#define __RINGBUF_PIPE_H__
+
+/**
+ * @file ringbuf_pipe.h Staged pipeline ringbuf: elements flow through
+ * several processing stages in place.
+ */
+
+#include "ringbuf.h"
+
+/**
+ * Per-stage state of a ringbuf_pipe, one cache line each.
+ */
+struct ringbuf_pipe_stage {
+    /** Next position this stage will claim. Written only by the stage. */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t pos;
+    /** Stage's cached copy of the position it may claim up to */
+    size_t limit_cache;
+};
+
+/**
+ * Staged pipeline over one element array (disruptor style).
+ *
+ * Stage 0 produces elements, each later stage processes them in place
+ * after the stage before it, and the last stage's publish frees their
+ * slots for stage 0 again. Every stage claims a batch of up to N slots,
+ * reads or modifies them in place and publishes them to the next stage,
+ * so there is no copying between stages and a single allocation for the
+ * whole pipeline.
+ *
+ * Each stage may run on its own thread without locks; only the thread
+ * owning a stage may claim or publish for it.
+ */
+struct ringbuf_pipe {
+    /** Base pointer of element array */
+    void *buf;
+    /** Stage state, n_stages entries */
+    struct ringbuf_pipe_stage *stages;
+    /** Number of stages, including the producing stage 0 */
+    size_t n_stages;
+    /** Maximum number of elements that can be in flight, a power of two */
+    size_t capacity;
+    /** capacity - 1 */
+    size_t mask;
+    /** Size of each element (bytes) */
+    size_t elem_sz;
+};
+
+int ringbuf_pipe_init(struct ringbuf_pipe *p, void *buf, struct ringbuf_pipe_stage *stages,
+        size_t n_stages, size_t n_elem, size_t elem_sz);
+size_t ringbuf_pipe_count(const struct ringbuf_pipe *p, size_t stage);
+size_t ringbuf_pipe_claim(struct ringbuf_pipe *p, size_t stage, size_t max,
+        struct ringbuf_span spans[2]);
+void *ringbuf_pipe_claim_span(struct ringbuf_pipe *p, size_t stage, size_t *n);
+int ringbuf_pipe_publish(struct ringbuf_pipe *p, size_t stage, size_t n);
+
+#endif
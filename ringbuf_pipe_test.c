@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_pipe_test.c Example usage for the staged pipeline ringbuf.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "ringbuf_pipe.h"
+
+#define ELEMS_BUF_LEN 16
+#define N_STAGES 4
+#define N_ITEMS 100000
+#define BATCH 5
+
+struct msg {
+    int seq;
+    int parsed;
+    int enriched;
+};
+
+static struct ringbuf_pipe pipe_rb;
+
+static void test_pipe_basic(void)
+{
+    struct msg buf[ELEMS_BUF_LEN];
+    struct ringbuf_pipe_stage stages[3];
+    struct ringbuf_pipe p;
+    struct ringbuf_span spans[2];
+    struct msg *m;
+    size_t n;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_pipe_init(&p, buf, stages, 1, ELEMS_BUF_LEN, sizeof(*m)));
+    assert(-1 == ringbuf_pipe_init(&p, buf, stages, 3, ELEMS_BUF_LEN - 1, sizeof(*m)));
+    assert(0 == ringbuf_pipe_init(&p, buf, stages, 3, ELEMS_BUF_LEN, sizeof(*m)));
+    assert(ELEMS_BUF_LEN == ringbuf_pipe_count(&p, 0));
+    assert(0 == ringbuf_pipe_count(&p, 1) && 0 == ringbuf_pipe_claim(&p, 1, BATCH, spans));
+    assert(-1 == ringbuf_pipe_publish(&p, 1, 1));
+
+    // produce 12
+    assert(12 == ringbuf_pipe_claim(&p, 0, 12, spans) && 0 == spans[1].n);
+    m = spans[0].ptr;
+    for (int i = 0; i < 12; i++) {
+        m[i].seq = i;
+    }
+    assert(0 == ringbuf_pipe_publish(&p, 0, 12));
+
+    // stage 1 handles 10 of them, stage 2 frees 8
+    assert(10 == ringbuf_pipe_claim(&p, 1, 10, spans));
+    for (size_t i = 0; i < spans[0].n; i++) {
+        ((struct msg *)spans[0].ptr)[i].parsed = 1;
+    }
+    assert(0 == ringbuf_pipe_publish(&p, 1, 10));
+    assert(2 == ringbuf_pipe_count(&p, 1) && 10 == ringbuf_pipe_count(&p, 2));
+    assert(0 == ringbuf_pipe_publish(&p, 2, 8));
+    assert(ELEMS_BUF_LEN - 4 == ringbuf_pipe_count(&p, 0));
+
+    // the producer's next claim wraps
+    assert(12 == ringbuf_pipe_claim(&p, 0, 100, spans));
+    assert(4 == spans[0].n && buf + 12 == spans[0].ptr);
+    assert(8 == spans[1].n && buf == spans[1].ptr);
+    assert(buf + 12 == ringbuf_pipe_claim_span(&p, 0, &n) && 4 == n);
+    assert(-1 == ringbuf_pipe_publish(&p, 0, 13));
+    assert(0 == ringbuf_pipe_publish(&p, 0, 12));
+    assert(0 == ringbuf_pipe_count(&p, 0));
+    assert(NULL == ringbuf_pipe_claim_span(&p, 0, &n) && 0 == n);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void *pipe_stage(void *arg)
+{
+    size_t stage = (size_t)arg;
+    struct ringbuf_span spans[2];
+    int next = 0;
+
+    while (next < N_ITEMS) {
+        size_t n = ringbuf_pipe_claim(&pipe_rb, stage, BATCH, spans);
+
+        if (!n) {
+            sched_yield();
+            continue;
+        }
+        for (int s = 0; s < 2; s++) {
+            struct msg *m = spans[s].ptr;
+
+            for (size_t i = 0; i < spans[s].n; i++, next++) {
+                switch (stage) {
+                case 0:
+                    m[i].seq = next;
+                    m[i].parsed = m[i].enriched = 0;
+                    break;
+                case 1:
+                    assert(m[i].seq == next && !m[i].parsed);
+                    m[i].parsed = 1;
+                    break;
+                case 2:
+                    assert(m[i].seq == next && m[i].parsed);
+                    m[i].enriched = next * 2;
+                    break;
+                default:
+                    assert(m[i].seq == next && m[i].parsed && m[i].enriched == next * 2);
+                    break;
+                }
+            }
+        }
+        assert(0 == ringbuf_pipe_publish(&pipe_rb, stage, n));
+    }
+    return NULL;
+}
+
+static void test_pipe_threads(void)
+{
+    struct msg buf[ELEMS_BUF_LEN];
+    struct ringbuf_pipe_stage stages[N_STAGES];
+    pthread_t threads[N_STAGES];
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_pipe_init(&pipe_rb, buf, stages, N_STAGES, ELEMS_BUF_LEN, sizeof(buf[0])));
+    for (size_t i = 0; i < N_STAGES; i++) {
+        assert(0 == pthread_create(&threads[i], NULL, pipe_stage, (void *)i));
+    }
+    for (size_t i = 0; i < N_STAGES; i++) {
+        assert(0 == pthread_join(threads[i], NULL));
+    }
+    assert(ELEMS_BUF_LEN == ringbuf_pipe_count(&pipe_rb, 0));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_pipe_basic();
+    test_pipe_threads();
+
+    return 0;
+}
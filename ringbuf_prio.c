@@ -0,0 +1,202 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_prio.c Priority ordered ringbuf.
+ *
+ * index[0] is the head. index[i] comes out no later than index[2i + 1] and
+ * index[2i + 2]. Only index entries are swapped while the heap is
+ * restored; the elements themselves stay in their slots.
+ */
+#include <string.h>
+
+#include "ringbuf_prio.h"
+
+static inline void *ringbuf_prio_slot(const struct ringbuf_prio *rb, size_t slot)
+{
+    return (char *)rb->buf + rb->elem_sz * slot;
+}
+
+// does a come out before b?
+static inline int ringbuf_prio_before(const struct ringbuf_prio *rb,
+        const struct ringbuf_prio_ent *a, const struct ringbuf_prio_ent *b)
+{
+    int cmp = (*rb->ops.elem_cmp)(ringbuf_prio_slot(rb, a->slot), ringbuf_prio_slot(rb, b->slot));
+
+    // sequence numbers wrap, compare their distance
+    return cmp < 0 || (cmp == 0 && (ptrdiff_t)(a->seq - b->seq) < 0);
+}
+
+static void ringbuf_prio_sift_up(struct ringbuf_prio *rb, size_t i)
+{
+    struct ringbuf_prio_ent ent = rb->index[i];
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+
+        if (!ringbuf_prio_before(rb, &ent, &rb->index[parent])) {
+            break;
+        }
+        rb->index[i] = rb->index[parent];
+        i = parent;
+    }
+    rb->index[i] = ent;
+}
+
+static void ringbuf_prio_sift_down(struct ringbuf_prio *rb, size_t i)
+{
+    struct ringbuf_prio_ent ent = rb->index[i];
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+
+        if (child >= rb->count) {
+            break;
+        }
+        if (child + 1 < rb->count && ringbuf_prio_before(rb, &rb->index[child + 1],
+                    &rb->index[child])) {
+            child++;
+        }
+        if (!ringbuf_prio_before(rb, &rb->index[child], &ent)) {
+            break;
+        }
+        rb->index[i] = rb->index[child];
+        i = child;
+    }
+    rb->index[i] = ent;
+}
+
+/**
+ * Initialize a ringbuf_prio struct.
+ *
+ * Same external storage model as ringbuf_init: buf must hold n_elem
+ * elements of elem_sz bytes. In addition, index must point to an array of
+ * n_elem struct ringbuf_prio_ent. No memory allocation is performed.
+ *
+ * @param rb pointer to the ringbuf_prio struct to initialize
+ * @param buf pointer to the array buffer
+ * @param index pointer to the index array
+ * @param n_elem maximum number of elements buf can hold
+ * @param elem_sz the size (bytes) of each element
+ * @param elem_cmp element comparator, see ringbuf_prio.ops.elem_cmp
+ * @return 0 on success, -1 if rb, buf, index or elem_cmp are NULL
+ */
+int ringbuf_prio_init(struct ringbuf_prio *rb, const void *buf, struct ringbuf_prio_ent *index,
+        size_t n_elem, size_t elem_sz, int (*elem_cmp)(const void *a, const void *b))
+{
+    if (!rb || !buf || !index || !elem_cmp) {
+        return -1;
+    }
+
+    rb->buf = buf;
+    rb->index = index;
+    rb->capacity = n_elem;
+    rb->elem_sz = elem_sz;
+    rb->count = 0;
+    rb->next_seq = 0;
+    rb->ops.elem_cmp = elem_cmp;
+    rb->ops.elem_copy = NULL;
+    for (size_t i = 0; i < n_elem; i++) {
+        index[i].slot = i;
+        index[i].seq = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the number of elements currently stored.
+ */
+size_t ringbuf_prio_count(const struct ringbuf_prio *rb)
+{
+    return rb->count;
+}
+
+/**
+ * Adds an element in priority order, after any equal elements. O(log n).
+ * @param elem element to add. If NULL, the ringbuf is not modified and 0 is returned.
+ * @return 0 on success, -1 if ringbuf is full
+ */
+int ringbuf_prio_add(struct ringbuf_prio *rb, const void *elem)
+{
+    struct ringbuf_prio_ent *ent;
+    void *tp;
+
+    if (!elem) {
+        return 0;
+    }
+    if (rb->count == rb->capacity) {
+        return -1;
+    }
+
+    // the first free slot number sits right after the heap
+    ent = &rb->index[rb->count];
+    tp = ringbuf_prio_slot(rb, ent->slot);
+    if (rb->ops.elem_copy) {
+        (*rb->ops.elem_copy)(tp, elem);
+    } else {
+        memcpy(tp, elem, rb->elem_sz);
+    }
+    ent->seq = rb->next_seq++;
+    ringbuf_prio_sift_up(rb, rb->count++);
+
+    return 0;
+}
+
+/**
+ * Returns the head (first in priority order) element for in-place
+ * reading. O(1).
+ * @return pointer to the head element, NULL if the ringbuf is empty
+ */
+void *ringbuf_prio_peek_head(struct ringbuf_prio *rb)
+{
+    return rb->count ? ringbuf_prio_slot(rb, rb->index[0].slot) : NULL;
+}
+
+/**
+ * Removes the element returned by ringbuf_prio_peek_head. O(log n).
+ * @return 0 on success, -1 if the ringbuf is empty
+ */
+int ringbuf_prio_release_head(struct ringbuf_prio *rb)
+{
+    struct ringbuf_prio_ent head;
+
+    if (!rb->count) {
+        return -1;
+    }
+
+    // the last heap entry takes the head's place, the head's slot becomes
+    // the first free one
+    head = rb->index[0];
+    rb->count--;
+    rb->index[0] = rb->index[rb->count];
+    rb->index[rb->count] = head;
+    if (rb->count) {
+        ringbuf_prio_sift_down(rb, 0);
+    }
+
+    return 0;
+}
+
+/**
+ * Removes the head (first in priority order) element. O(log n).
+ * @param elem where to copy the removed element. If NULL, the element is simply removed.
+ * @return 0 on success, -1 if ringbuf is empty
+ */
+int ringbuf_prio_remove_head(struct ringbuf_prio *rb, void *elem)
+{
+    void *hp = ringbuf_prio_peek_head(rb);
+
+    if (!hp) {
+        return -1;
+    }
+    if (elem) {
+        if (rb->ops.elem_copy) {
+            (*rb->ops.elem_copy)(elem, hp);
+        } else {
+            memcpy(elem, hp, rb->elem_sz);
+        }
+    }
+    return ringbuf_prio_release_head(rb);
+}
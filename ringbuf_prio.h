@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_PRIO_H__
+#define __RINGBUF_PRIO_H__
+
+/**
+ * @file ringbuf_prio.h Priority ordered variant of the ringbuf: elements
+ * come out in comparator order, FIFO among equal keys.
+ */
+
+#include <stddef.h>
+
+/** Index entry of a ringbuf_prio, see ringbuf_prio_init */
+struct ringbuf_prio_ent {
+    /** Storage slot of the element */
+    size_t slot;
+    /** Insertion sequence number, breaks ties in FIFO order */
+    size_t seq;
+};
+
+/**
+ * Priority ringbuf.
+ *
+ * Elements are copied into a free slot of buf once and never move. Their
+ * order is kept in a binary heap of slot numbers (the index), so adding is
+ * O(log n) no matter how large the elements are, the head element can be
+ * looked at in place in O(1), and removing it is O(log n).
+ *
+ * Not thread safe, use external locking to share one between threads.
+ */
+struct ringbuf_prio {
+    /** Base pointer of element array */
+    const void *buf;
+    /**
+     * capacity entries: the first count form the heap, the rest hold the
+     * free slot numbers
+     */
+    struct ringbuf_prio_ent *index;
+    /** Maximum number of elements that can be stored */
+    size_t capacity;
+    /** Size of each element (bytes) */
+    size_t elem_sz;
+    /** Number of elements stored */
+    size_t count;
+    /** Sequence number for the next element added */
+    size_t next_seq;
+
+    /** Function pointers (callbacks) for custom operations */
+    struct {
+        /**
+         * Required: orders elements, returning < 0 if a comes out before b,
+         * > 0 if after and 0 if they are equal (then FIFO order applies).
+         */
+        int (*elem_cmp)(const void *a, const void *b);
+        /**
+         * Optional user provided function that implements copying an element from src
+         * to dst. If not set, memcpy is used by default.
+         */
+        void (*elem_copy)(void *dst, const void *src);
+    } ops;
+};
+
+int ringbuf_prio_init(struct ringbuf_prio *rb, const void *buf, struct ringbuf_prio_ent *index,
+        size_t n_elem, size_t elem_sz, int (*elem_cmp)(const void *a, const void *b));
+size_t ringbuf_prio_count(const struct ringbuf_prio *rb);
+int ringbuf_prio_add(struct ringbuf_prio *rb, const void *elem);
+int ringbuf_prio_remove_head(struct ringbuf_prio *rb, void *elem);
+void *ringbuf_prio_peek_head(struct ringbuf_prio *rb);
+int ringbuf_prio_release_head(struct ringbuf_prio *rb);
+
+#endif
@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_prio_test.c Example usage for the priority ringbuf.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ringbuf_prio.h"
+
+#define ELEMS_BUF_LEN 8
+
+struct job {
+    unsigned deadline;
+    int id;
+};
+
+static int cmp_deadline(const void *a, const void *b)
+{
+    const struct job *ja = a, *jb = b;
+
+    return (ja->deadline > jb->deadline) - (ja->deadline < jb->deadline);
+}
+
+static void test_prio_order(void)
+{
+    struct job buf[ELEMS_BUF_LEN], job, *p;
+    struct ringbuf_prio_ent index[ELEMS_BUF_LEN];
+    struct ringbuf_prio rb;
+    const unsigned deadlines[ELEMS_BUF_LEN] = { 50, 10, 30, 10, 70, 30, 10, 5 };
+    const int tens[] = { 1, 3, 6 }, rest[] = { 100, 5, 101, 0, 4 };
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_prio_init(&rb, buf, index, ELEMS_BUF_LEN, sizeof(job), NULL));
+    assert(0 == ringbuf_prio_init(&rb, buf, index, ELEMS_BUF_LEN, sizeof(job), cmp_deadline));
+    assert(NULL == ringbuf_prio_peek_head(&rb));
+    assert(-1 == ringbuf_prio_remove_head(&rb, &job));
+
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        job.deadline = deadlines[i];
+        job.id = i;
+        assert(0 == ringbuf_prio_add(&rb, &job));
+    }
+    assert(-1 == ringbuf_prio_add(&rb, &job)); // full
+    assert(ELEMS_BUF_LEN == ringbuf_prio_count(&rb));
+
+    // earliest deadline first, equal deadlines in the order they were added
+    p = ringbuf_prio_peek_head(&rb);
+    assert(p && p->deadline == 5 && p->id == 7);
+    assert(0 == ringbuf_prio_release_head(&rb));
+    for (int i = 0; i < 3; i++) {
+        assert(0 == ringbuf_prio_remove_head(&rb, &job));
+        assert(job.deadline == 10 && job.id == tens[i]);
+    }
+    assert(0 == ringbuf_prio_remove_head(&rb, &job) && job.id == 2);
+
+    // freed slots are reused, inserts still land in order
+    job.deadline = 1;
+    job.id = 100;
+    assert(0 == ringbuf_prio_add(&rb, &job));
+    job.deadline = 30;
+    job.id = 101;
+    assert(0 == ringbuf_prio_add(&rb, &job));
+    for (int i = 0; i < 5; i++) {
+        assert(0 == ringbuf_prio_remove_head(&rb, &job));
+        assert(job.id == rest[i]);
+    }
+    assert(0 == ringbuf_prio_count(&rb));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+// random interleaved adds and removes against qsort
+static void test_prio_random(void)
+{
+    int buf[256], sorted[256], x, last;
+    struct ringbuf_prio_ent index[256];
+    struct ringbuf_prio rb;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    srand(1);
+    assert(0 == ringbuf_prio_init(&rb, buf, index, 256, sizeof(int), cmp_int));
+    for (int round = 0; round < 100; round++) {
+        int n_add = rand() % 64, n_remove = rand() % 64;
+
+        for (int i = 0; i < n_add; i++) {
+            x = rand() % 1000;
+            if (ringbuf_prio_add(&rb, &x) < 0) {
+                assert(256 == ringbuf_prio_count(&rb));
+            }
+        }
+        last = -1;
+        for (int i = 0; i < n_remove && ringbuf_prio_remove_head(&rb, &x) == 0; i++) {
+            assert(x >= last);
+            last = x;
+        }
+    }
+
+    // drain matches a sort of what is left
+    for (size_t i = 0; i < rb.count; i++) {
+        sorted[i] = buf[index[i].slot];
+    }
+    qsort(sorted, rb.count, sizeof(int), cmp_int);
+    for (size_t i = 0, n = rb.count; i < n; i++) {
+        assert(0 == ringbuf_prio_remove_head(&rb, &x) && x == sorted[i]);
+    }
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_prio_order();
+    test_prio_random();
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_rec.c Variable length records on top of a byte ringbuf.
+ */
+#include <string.h>
+
+#include "ringbuf_rec.h"
+
+static inline size_t ringbuf_rec_frame_sz(size_t len)
+{
+    return (sizeof(struct ringbuf_rec_hdr) + len + RINGBUF_REC_ALIGN - 1) &
+        ~(size_t)(RINGBUF_REC_ALIGN - 1);
+}
+
+/**
+ * Initialize a ringbuf for variable length records.
+ *
+ * @param rb pointer to the ringbuf struct to initialize
+ * @param buf pointer to the storage, aligned to RINGBUF_REC_ALIGN
+ * @param buf_sz size of the storage (bytes), a multiple of RINGBUF_REC_ALIGN,
+ * at most UINT32_MAX
+ * @param flags RINGBUF_F_* flags, RINGBUF_F_POW2 is detected automatically.
+ * RINGBUF_F_OVERWRITE is rejected: dropping single bytes off the head would
+ * cut through record headers. So are RINGBUF_F_GROW/RINGBUF_F_SHRINK and
+ * RINGBUF_F_MIRRORED, which need their own init functions.
+ * @return 0 on success, -1 on invalid arguments
+ */
+int ringbuf_rec_init(struct ringbuf *rb, void *buf, size_t buf_sz, unsigned flags)
+{
+    if (!buf_sz || buf_sz > UINT32_MAX || (buf_sz % RINGBUF_REC_ALIGN) ||
+            ((size_t)buf % RINGBUF_REC_ALIGN)) {
+        return -1;
+    }
+    if (flags & (RINGBUF_F_OVERWRITE | RINGBUF_F_GROW | RINGBUF_F_SHRINK | RINGBUF_F_MIRRORED)) {
+        return -1;
+    }
+    if (!(buf_sz & (buf_sz - 1))) {
+        flags |= RINGBUF_F_POW2;
+    }
+    return ringbuf_init_flags(rb, buf, buf_sz, 1, flags);
+}
+
+/**
+ * Reserves room for a record of up to len bytes to be written in place.
+ *
+ * May publish a skip frame to move past the end of the storage, even if
+ * it then returns NULL. Producer side.
+ * @param len maximum payload length (bytes)
+ * @return pointer to the payload, NULL if there is not enough room
+ */
+void *ringbuf_rec_reserve(struct ringbuf *rb, size_t len)
+{
+    size_t frame_sz = ringbuf_rec_frame_sz(len);
+    struct ringbuf_rec_hdr *hdr;
+    size_t n;
+
+    if (rb->elem_sz != 1 || frame_sz > rb->capacity || len >= RINGBUF_REC_SKIP) {
+        return NULL;
+    }
+
+    hdr = ringbuf_reserve_tail_span(rb, &n);
+    if (hdr && n < frame_sz && !(rb->flags & RINGBUF_F_MIRRORED) &&
+            (char *)hdr + n == (char *)rb->buf + rb->capacity) {
+        // the rest of the storage is free but too short, skip to the start
+        hdr->len = RINGBUF_REC_SKIP;
+        hdr->size = (uint32_t)n;
+        ringbuf_commit_tail_n(rb, n);
+        hdr = ringbuf_reserve_tail_span(rb, &n);
+    }
+    if (!hdr || n < frame_sz) {
+        return NULL;
+    }
+
+    hdr->len = (uint32_t)len;
+    hdr->size = (uint32_t)frame_sz;
+    return hdr + 1;
+}
+
+/**
+ * Publishes the record reserved by ringbuf_rec_reserve.
+ * @param len actual payload length, may be less than the reserved length
+ * @return 0 on success, -1 if len exceeds the reservation
+ */
+int ringbuf_rec_commit(struct ringbuf *rb, size_t len)
+{
+    struct ringbuf_rec_hdr *hdr;
+    size_t n;
+
+    hdr = ringbuf_reserve_tail_span(rb, &n);
+    if (!hdr || n < sizeof(*hdr) || len > hdr->len) {
+        return -1;
+    }
+
+    hdr->len = (uint32_t)len;
+    hdr->size = (uint32_t)ringbuf_rec_frame_sz(len);
+    return ringbuf_commit_tail_n(rb, hdr->size);
+}
+
+/**
+ * Copies a record into the ringbuf.
+ * @return 0 on success, -1 if there is not enough room
+ */
+int ringbuf_rec_add(struct ringbuf *rb, const void *rec, size_t len)
+{
+    void *p = ringbuf_rec_reserve(rb, len);
+
+    if (!p) {
+        return -1;
+    }
+    memcpy(p, rec, len);
+    return ringbuf_rec_commit(rb, len);
+}
+
+/**
+ * Returns the record at the head for in-place reading, stepping over any
+ * skip frame. The record stays in the ringbuf until ringbuf_rec_release.
+ * Consumer side.
+ * @param len set to the payload length (bytes)
+ * @return pointer to the payload, NULL if there are no records
+ */
+void *ringbuf_rec_peek(struct ringbuf *rb, size_t *len)
+{
+    struct ringbuf_rec_hdr *hdr;
+    size_t n;
+
+    hdr = ringbuf_peek_head_span(rb, &n);
+    if (hdr && hdr->len == RINGBUF_REC_SKIP) {
+        ringbuf_release_head_n(rb, hdr->size);
+        hdr = ringbuf_peek_head_span(rb, &n);
+    }
+    if (!hdr) {
+        return NULL;
+    }
+
+    *len = hdr->len;
+    return hdr + 1;
+}
+
+/**
+ * Releases the record returned by ringbuf_rec_peek.
+ * @return 0 on success, -1 if there are no records
+ */
+int ringbuf_rec_release(struct ringbuf *rb)
+{
+    struct ringbuf_rec_hdr *hdr;
+    size_t len;
+
+    hdr = ringbuf_rec_peek(rb, &len);
+    if (!hdr) {
+        return -1;
+    }
+    return ringbuf_release_head_n(rb, hdr[-1].size);
+}
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_REC_H__
+#define __RINGBUF_REC_H__
+
+/**
+ * @file ringbuf_rec.h Variable length records on top of a byte ringbuf.
+ *
+ * Records are stored as length-prefixed frames in a ringbuf with
+ * elem_sz == 1. A frame never wraps: when a record does not fit before
+ * the end of the storage, the remainder is filled with a skip frame and
+ * the record starts over at the beginning. Mirrored ringbufs
+ * (ringbuf_init_mirrored) never need skip frames.
+ *
+ * Same single-producer/single-consumer rules as struct ringbuf.
+ */
+
+#include <stdint.h>
+
+#include "ringbuf.h"
+
+/** Frames (and so the storage size) are aligned to this many bytes */
+#define RINGBUF_REC_ALIGN 8
+
+/** Frame length marking padding up to the end of the storage */
+#define RINGBUF_REC_SKIP UINT32_MAX
+
+/**
+ * Frame header, followed by the record payload.
+ */
+struct ringbuf_rec_hdr {
+    /** Payload length (bytes), or RINGBUF_REC_SKIP */
+    uint32_t len;
+    /** Total frame size including header and padding (bytes) */
+    uint32_t size;
+};
+
+int ringbuf_rec_init(struct ringbuf *rb, void *buf, size_t buf_sz, unsigned flags);
+void *ringbuf_rec_reserve(struct ringbuf *rb, size_t len);
+int ringbuf_rec_commit(struct ringbuf *rb, size_t len);
+int ringbuf_rec_add(struct ringbuf *rb, const void *rec, size_t len);
+void *ringbuf_rec_peek(struct ringbuf *rb, size_t *len);
+int ringbuf_rec_release(struct ringbuf *rb);
+
+#endif
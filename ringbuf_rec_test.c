@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_rec_test.c Example usage for variable length records.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ringbuf_rec.h"
+
+#define REC_BUF_SZ 256
+#define N_ITEMS 100000
+
+// record i has length i % 61 bytes filled with (char)i
+static size_t rec_len(int i)
+{
+    return i % 61;
+}
+
+static void rec_fill(char *p, int i)
+{
+    memset(p, (char)i, rec_len(i));
+}
+
+static void rec_check(const char *p, size_t len, int i)
+{
+    assert(len == rec_len(i));
+    for (size_t j = 0; j < len; j++) {
+        assert(p[j] == (char)i);
+    }
+}
+
+static void test_rec_basic(void)
+{
+    _Alignas(RINGBUF_REC_ALIGN) char buf[REC_BUF_SZ];
+    struct ringbuf rb;
+    char *p;
+    size_t len;
+    int next_in = 0, next_out = 0;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_rec_init(&rb, buf, REC_BUF_SZ - 1, 0));
+    // byte-wise dropping would break the framing
+    assert(-1 == ringbuf_rec_init(&rb, buf, REC_BUF_SZ, RINGBUF_F_OVERWRITE));
+    assert(-1 == ringbuf_rec_init(&rb, buf, REC_BUF_SZ, RINGBUF_F_MIRRORED));
+    assert(0 == ringbuf_rec_init(&rb, buf, REC_BUF_SZ, 0));
+    assert(NULL == ringbuf_rec_peek(&rb, &len));
+    assert(-1 == ringbuf_rec_release(&rb));
+    assert(NULL == ringbuf_rec_reserve(&rb, REC_BUF_SZ)); // can never fit
+
+    // reserve the maximum, commit less
+    p = ringbuf_rec_reserve(&rb, 100);
+    assert(p);
+    memcpy(p, "hello", 5);
+    assert(-1 == ringbuf_rec_commit(&rb, 101));
+    assert(0 == ringbuf_rec_commit(&rb, 5));
+    p = ringbuf_rec_peek(&rb, &len);
+    assert(p && len == 5 && 0 == memcmp(p, "hello", 5));
+    assert(0 == ringbuf_rec_release(&rb));
+    assert(ringbuf_empty(&rb));
+
+    // many wraps with skip frames
+    for (int round = 0; round < 200; round++) {
+        while ((p = ringbuf_rec_reserve(&rb, rec_len(next_in))) != NULL) {
+            rec_fill(p, next_in);
+            assert(0 == ringbuf_rec_commit(&rb, rec_len(next_in)));
+            next_in++;
+        }
+        for (int i = 0; i < 1 + round % 3; i++) {
+            if ((p = ringbuf_rec_peek(&rb, &len)) == NULL) {
+                break;
+            }
+            rec_check(p, len, next_out++);
+            assert(0 == ringbuf_rec_release(&rb));
+        }
+    }
+    while ((p = ringbuf_rec_peek(&rb, &len)) != NULL) {
+        rec_check(p, len, next_out++);
+        assert(0 == ringbuf_rec_release(&rb));
+    }
+    assert(next_in == next_out);
+    assert(ringbuf_empty(&rb));
+    printf("%d records\n", next_out);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_rec_mirrored(void)
+{
+    struct ringbuf rb;
+    char *p;
+    size_t len;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_init_mirrored(&rb, 1, 1, 0));
+    // step close to the end, then store a record straddling it
+    assert(0 == ringbuf_rec_add(&rb, "x", 1));
+    assert(0 == ringbuf_commit_tail_n(&rb, rb.capacity - 3 * RINGBUF_REC_ALIGN));
+    assert(0 == ringbuf_release_head_n(&rb, rb.capacity - RINGBUF_REC_ALIGN));
+    assert(0 == ringbuf_rec_add(&rb, "0123456789abcdef0123", 20));
+    p = ringbuf_rec_peek(&rb, &len);
+    assert(p && len == 20 && 0 == memcmp(p, "0123456789abcdef0123", 20));
+    assert(p + len > (char *)rb.buf + rb.capacity);
+    assert(0 == ringbuf_rec_release(&rb));
+    assert(ringbuf_empty(&rb));
+    ringbuf_free_mirrored(&rb);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void *rec_producer(void *arg)
+{
+    struct ringbuf *rb = arg;
+    char *p;
+
+    for (int i = 0; i < N_ITEMS; i++) {
+        while ((p = ringbuf_rec_reserve(rb, rec_len(i))) == NULL) {
+            sched_yield();
+        }
+        rec_fill(p, i);
+        assert(0 == ringbuf_rec_commit(rb, rec_len(i)));
+    }
+    return NULL;
+}
+
+static void test_rec_threads(void)
+{
+    _Alignas(RINGBUF_REC_ALIGN) char buf[REC_BUF_SZ + 8 * RINGBUF_REC_ALIGN];
+    struct ringbuf rb;
+    pthread_t producer;
+    char *p;
+    size_t len;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    // not a power of two
+    assert(0 == ringbuf_rec_init(&rb, buf, sizeof(buf), 0));
+    assert(0 == pthread_create(&producer, NULL, rec_producer, &rb));
+    for (int i = 0; i < N_ITEMS; i++) {
+        while ((p = ringbuf_rec_peek(&rb, &len)) == NULL) {
+            sched_yield();
+        }
+        rec_check(p, len, i);
+        assert(0 == ringbuf_rec_release(&rb));
+    }
+    assert(0 == pthread_join(producer, NULL));
+    assert(ringbuf_empty(&rb));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_rec_basic();
+    test_rec_mirrored();
+    test_rec_threads();
+
+    return 0;
+}
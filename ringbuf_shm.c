@@ -0,0 +1,502 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_shm.c Cross-process ringbuf in a shared memory segment.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ringbuf_shm.h"
+
+// element storage starts on the cache line after the control block
+#define RINGBUF_SHM_DATA_OFF \
+    ((sizeof(struct ringbuf_shm) + RINGBUF_CACHELINE - 1) & ~(size_t)(RINGBUF_CACHELINE - 1))
+
+static inline void *ringbuf_shm_slot(const struct ringbuf_shm *rb, uint64_t idx)
+{
+    return (char *)rb + rb->data_off + rb->elem_sz * (idx & (rb->capacity - 1));
+}
+
+/**
+ * Returns the segment size (bytes) needed for n_elem elements of elem_sz bytes.
+ */
+size_t ringbuf_shm_size(size_t n_elem, size_t elem_sz)
+{
+    return RINGBUF_SHM_DATA_OFF + n_elem * elem_sz;
+}
+
+// write a complete header for an empty ringbuf, leaving magic at 0
+static struct ringbuf_shm *ringbuf_shm_format_hdr(void *mem, size_t mem_sz, size_t n_elem,
+        size_t elem_sz, uint64_t flags)
+{
+    struct ringbuf_shm *rb = mem;
+
+    if (!mem || ((size_t)mem % RINGBUF_CACHELINE) || !n_elem || (n_elem & (n_elem - 1)) ||
+            mem_sz < ringbuf_shm_size(n_elem, elem_sz)) {
+        return NULL;
+    }
+
+    atomic_store_explicit(&rb->magic, 0, memory_order_relaxed);
+    rb->version = RINGBUF_SHM_VERSION;
+    rb->capacity = n_elem;
+    rb->elem_sz = elem_sz;
+    rb->data_off = RINGBUF_SHM_DATA_OFF;
+    rb->seg_sz = mem_sz;
+    rb->flags = flags;
+    atomic_store_explicit(&rb->tail, 0, memory_order_relaxed);
+    rb->head_cache = 0;
+    atomic_store_explicit(&rb->sync_tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&rb->head, 0, memory_order_relaxed);
+    rb->tail_cache = 0;
+    atomic_store_explicit(&rb->sync_head, 0, memory_order_relaxed);
+    atomic_store_explicit(&rb->reuse_head, 0, memory_order_relaxed);
+
+    return rb;
+}
+
+/**
+ * Formats a new, empty ringbuf in already mapped (shared) memory.
+ *
+ * mem can come from any mapping: POSIX shm, a hugetlbfs file, etc.
+ * It must be at least RINGBUF_CACHELINE aligned, which any mmap is.
+ *
+ * @param mem start of the segment
+ * @param mem_sz size of the segment (bytes), at least ringbuf_shm_size(n_elem, elem_sz)
+ * @param n_elem maximum number of elements, must be a power of two
+ * @param elem_sz the size (bytes) of each element
+ * @return the control block (== mem), NULL on invalid arguments
+ */
+struct ringbuf_shm *ringbuf_shm_format(void *mem, size_t mem_sz, size_t n_elem, size_t elem_sz)
+{
+    struct ringbuf_shm *rb = ringbuf_shm_format_hdr(mem, mem_sz, n_elem, elem_sz, 0);
+
+    if (rb) {
+        // publish the formatted header to attaching processes
+        atomic_store_explicit(&rb->magic, RINGBUF_SHM_MAGIC, memory_order_release);
+    }
+    return rb;
+}
+
+/**
+ * Attaches to a ringbuf formatted by ringbuf_shm_format, possibly in
+ * another process and at another address.
+ * @param mem start of the segment
+ * @param mem_sz size of the mapping (bytes)
+ * @return the control block (== mem), NULL if the header is not valid
+ */
+struct ringbuf_shm *ringbuf_shm_attach(void *mem, size_t mem_sz)
+{
+    struct ringbuf_shm *rb = mem;
+
+    if (!mem || mem_sz < sizeof(*rb) ||
+            atomic_load_explicit(&rb->magic, memory_order_acquire) != RINGBUF_SHM_MAGIC ||
+            rb->version != RINGBUF_SHM_VERSION || !rb->capacity ||
+            (rb->capacity & (rb->capacity - 1)) || rb->data_off < sizeof(*rb) ||
+            rb->seg_sz > mem_sz || rb->data_off + rb->capacity * rb->elem_sz > rb->seg_sz) {
+        return NULL;
+    }
+    return rb;
+}
+
+/**
+ * Creates and maps a new POSIX shared memory object holding an empty ringbuf.
+ * @param name shm_open name, e.g. "/my_ring". Fails if it already exists.
+ * @return the mapped control block, NULL on failure
+ */
+struct ringbuf_shm *ringbuf_shm_create(const char *name, size_t n_elem, size_t elem_sz)
+{
+    size_t sz = ringbuf_shm_size(n_elem, elem_sz);
+    struct ringbuf_shm *rb;
+    void *mem;
+    int fd;
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, sz) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    mem = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    rb = ringbuf_shm_format(mem, sz, n_elem, elem_sz);
+    if (!rb) {
+        munmap(mem, sz);
+        shm_unlink(name);
+    }
+    return rb;
+}
+
+/**
+ * Maps an existing POSIX shared memory object created by ringbuf_shm_create.
+ * @return the mapped control block, NULL on failure
+ */
+struct ringbuf_shm *ringbuf_shm_open(const char *name)
+{
+    struct ringbuf_shm *rb;
+    size_t page, keep;
+    struct stat st;
+    void *mem;
+    int fd;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*rb)) {
+        close(fd);
+        return NULL;
+    }
+    mem = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+
+    rb = ringbuf_shm_attach(mem, st.st_size);
+    if (!rb) {
+        munmap(mem, st.st_size);
+        return NULL;
+    }
+    // keep only the recorded seg_sz mapped, which is what ringbuf_shm_close unmaps
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    keep = (rb->seg_sz + page - 1) & ~(page - 1);
+    if (keep < (size_t)st.st_size) {
+        munmap((char *)mem + keep, st.st_size - keep);
+    }
+    return rb;
+}
+
+/**
+ * Unmaps a segment mapped by ringbuf_shm_create/ringbuf_shm_open. The shm
+ * object itself stays until shm_unlink().
+ */
+void ringbuf_shm_close(struct ringbuf_shm *rb)
+{
+    if (rb) {
+        munmap(rb, rb->seg_sz);
+    }
+}
+
+// flush [p, p + n) of a file mapping, widened to whole pages
+static int ringbuf_shm_flush(const void *p, size_t n)
+{
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)p & ~(page - 1);
+
+    if (!n) {
+        return 0;
+    }
+    return msync((void *)start, (uintptr_t)p + n - start, MS_SYNC);
+}
+
+// fsync the directory holding path, so a newly created entry survives a crash
+static int ringbuf_shm_sync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    char *dir;
+    int fd, ret;
+
+    if (!slash) {
+        fd = open(".", O_RDONLY | O_DIRECTORY);
+    } else {
+        dir = strndup(path, slash == path ? 1 : (size_t)(slash - path));
+        if (!dir) {
+            return -1;
+        }
+        fd = open(dir, O_RDONLY | O_DIRECTORY);
+        free(dir);
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    ret = fsync(fd);
+    close(fd);
+    return ret;
+}
+
+/**
+ * Opens a persistent ringbuf in a regular file, creating it if needed.
+ *
+ * A new file's header is written and flushed before the magic number is
+ * written and flushed, so a crash during creation never leaves a valid
+ * looking but incomplete header, and the parent directory is synced so the
+ * new file itself survives a crash. An existing file is validated (magic, version, capacity, elem_sz
+ * and size) and recovered in O(1): tail and head restart at the last
+ * positions flushed by ringbuf_shm_sync_tail/ringbuf_shm_sync_head, and
+ * anything added or removed after those is discarded or redelivered.
+ * Elements are used in place, there is no replay or deserialization.
+ *
+ * Only one producer and one consumer may have the file open at a time.
+ *
+ * @param path file path
+ * @param n_elem maximum number of elements, must be a power of two
+ * @param elem_sz the size (bytes) of each element
+ * @return the mapped control block, NULL on failure (errno EINVAL if an
+ * existing file is not a matching ringbuf)
+ */
+struct ringbuf_shm *ringbuf_shm_open_file(const char *path, size_t n_elem, size_t elem_sz)
+{
+    size_t sz = ringbuf_shm_size(n_elem, elem_sz);
+    struct ringbuf_shm *rb;
+    struct stat st;
+    int created = 0;
+    void *mem;
+    int fd;
+
+    if (!n_elem || (n_elem & (n_elem - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        created = 1;
+        if (ftruncate(fd, sz) < 0) {
+            goto fail_unlink;
+        }
+    } else if (errno != EEXIST || (fd = open(path, O_RDWR)) < 0) {
+        return NULL;
+    } else if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    } else if ((size_t)st.st_size != sz) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    mem = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        goto fail_unlink;
+    }
+    close(fd);
+    fd = -1;
+
+    if (created) {
+        // the header must be complete on disk before the magic makes it valid
+        rb = ringbuf_shm_format_hdr(mem, sz, n_elem, elem_sz, RINGBUF_SHM_F_DURABLE);
+        if (ringbuf_shm_flush(rb, sizeof(*rb)) < 0) {
+            goto fail_unmap;
+        }
+        atomic_store_explicit(&rb->magic, RINGBUF_SHM_MAGIC, memory_order_release);
+        if (ringbuf_shm_flush(rb, sizeof(*rb)) < 0 || ringbuf_shm_sync_dir(path) < 0) {
+            goto fail_unmap;
+        }
+        return rb;
+    }
+
+    rb = ringbuf_shm_attach(mem, sz);
+    if (!rb || rb->capacity != n_elem || rb->elem_sz != elem_sz || rb->seg_sz != sz ||
+            !(rb->flags & RINGBUF_SHM_F_DURABLE) ||
+            rb->sync_tail - rb->sync_head > rb->capacity) {
+        munmap(mem, sz);
+        errno = EINVAL;
+        return NULL;
+    }
+    atomic_store_explicit(&rb->tail, rb->sync_tail, memory_order_relaxed);
+    atomic_store_explicit(&rb->head, rb->sync_head, memory_order_relaxed);
+    atomic_store_explicit(&rb->reuse_head, rb->sync_head, memory_order_relaxed);
+    rb->head_cache = rb->sync_head;
+    rb->tail_cache = rb->sync_tail;
+    return rb;
+
+fail_unmap:
+    munmap(mem, sz);
+fail_unlink:
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (created) {
+        unlink(path);
+    }
+    return NULL;
+}
+
+/**
+ * Makes all elements committed so far durable. Producer side.
+ *
+ * Flushes the elements added since the last sync, then stores the new
+ * sync_tail and flushes the header, so the persisted sync_tail never
+ * covers elements that are not on disk.
+ * @return 0 on success, -1 on msync failure (errno set)
+ */
+int ringbuf_shm_sync_tail(struct ringbuf_shm *rb)
+{
+    uint64_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    uint64_t from = atomic_load_explicit(&rb->sync_tail, memory_order_relaxed);
+    uint64_t mask = rb->capacity - 1;
+    uint64_t n = tail - from;
+    uint64_t first = rb->capacity - (from & mask);
+
+    if (!n) {
+        return 0;
+    }
+    if (n > first) {
+        if (ringbuf_shm_flush(ringbuf_shm_slot(rb, from), first * rb->elem_sz) < 0 ||
+                ringbuf_shm_flush(ringbuf_shm_slot(rb, 0), (n - first) * rb->elem_sz) < 0) {
+            return -1;
+        }
+    } else if (ringbuf_shm_flush(ringbuf_shm_slot(rb, from), n * rb->elem_sz) < 0) {
+        return -1;
+    }
+    atomic_store_explicit(&rb->sync_tail, tail, memory_order_release);
+    return ringbuf_shm_flush(rb, sizeof(*rb));
+}
+
+/**
+ * Makes all releases so far durable. Consumer side.
+ *
+ * In a persistent ringbuf the producer only reuses slots after this call,
+ * so elements removed but not yet synced are redelivered after a crash.
+ * @return 0 on success, -1 on msync failure (errno set)
+ */
+int ringbuf_shm_sync_head(struct ringbuf_shm *rb)
+{
+    uint64_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+
+    if (head == atomic_load_explicit(&rb->sync_head, memory_order_relaxed)) {
+        return 0;
+    }
+    atomic_store_explicit(&rb->sync_head, head, memory_order_relaxed);
+    if (ringbuf_shm_flush(rb, sizeof(*rb)) < 0) {
+        return -1;
+    }
+    // only now may the producer overwrite the released slots
+    atomic_store_explicit(&rb->reuse_head, head, memory_order_release);
+    return 0;
+}
+
+/**
+ * Returns the number of elements currently stored (a snapshot).
+ */
+size_t ringbuf_shm_count(const struct ringbuf_shm *rb)
+{
+    uint64_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+    return tail - head;
+}
+
+/**
+ * Returns the next free tail slot for in-place writing, see ringbuf_reserve_tail.
+ * @return pointer to the slot, NULL if the ringbuf is full
+ */
+void *ringbuf_shm_reserve_tail(struct ringbuf_shm *rb)
+{
+    uint64_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+    if (tail - rb->head_cache == rb->capacity) {
+        rb->head_cache = atomic_load_explicit(rb->flags & RINGBUF_SHM_F_DURABLE ?
+                &rb->reuse_head : &rb->head, memory_order_acquire);
+        if (tail - rb->head_cache == rb->capacity) {
+            return NULL;
+        }
+    }
+    return ringbuf_shm_slot(rb, tail);
+}
+
+/**
+ * Publishes the slot returned by ringbuf_shm_reserve_tail.
+ * @return 0 on success, -1 if the ringbuf is full
+ */
+int ringbuf_shm_commit_tail(struct ringbuf_shm *rb)
+{
+    uint64_t tail;
+
+    if (!ringbuf_shm_reserve_tail(rb)) {
+        return -1;
+    }
+    tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    atomic_store_explicit(&rb->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Returns the head element for in-place reading, see ringbuf_peek_head.
+ * With RINGBUF_SHM_F_DURABLE only elements made durable by
+ * ringbuf_shm_sync_tail are visible.
+ * @return pointer to the head element, NULL if the ringbuf is empty
+ */
+void *ringbuf_shm_peek_head(struct ringbuf_shm *rb)
+{
+    uint64_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+
+    if (head == rb->tail_cache) {
+        // a persistent consumer only sees elements already synced, so
+        // sync_head can never get ahead of sync_tail
+        rb->tail_cache = atomic_load_explicit(rb->flags & RINGBUF_SHM_F_DURABLE ?
+                &rb->sync_tail : &rb->tail, memory_order_acquire);
+        if (head == rb->tail_cache) {
+            return NULL;
+        }
+    }
+    return ringbuf_shm_slot(rb, head);
+}
+
+/**
+ * Releases the element returned by ringbuf_shm_peek_head.
+ * @return 0 on success, -1 if the ringbuf is empty
+ */
+int ringbuf_shm_release_head(struct ringbuf_shm *rb)
+{
+    uint64_t head;
+
+    if (!ringbuf_shm_peek_head(rb)) {
+        return -1;
+    }
+    head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    atomic_store_explicit(&rb->head, head + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Adds an element to the tail of the ringbuf. Producer side.
+ * @param elem element to add. If NULL, the ringbuf is not modified and 0 is returned.
+ * @return 0 on success, -1 if ringbuf is full
+ */
+int ringbuf_shm_add_tail(struct ringbuf_shm *rb, const void *elem)
+{
+    void *tp;
+
+    if (!elem) {
+        return 0;
+    }
+    tp = ringbuf_shm_reserve_tail(rb);
+    if (!tp) {
+        return -1;
+    }
+    memcpy(tp, elem, rb->elem_sz);
+    return ringbuf_shm_commit_tail(rb);
+}
+
+/**
+ * Removes an element from the head of the ringbuf. Consumer side.
+ * @param elem where to copy the removed element. If NULL, the element is simply removed.
+ * @return 0 on success, -1 if ringbuf is empty
+ */
+int ringbuf_shm_remove_head(struct ringbuf_shm *rb, void *elem)
+{
+    void *hp = ringbuf_shm_peek_head(rb);
+
+    if (!hp) {
+        return -1;
+    }
+    if (elem) {
+        memcpy(elem, hp, rb->elem_sz);
+    }
+    return ringbuf_shm_release_head(rb);
+}
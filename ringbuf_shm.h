@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_SHM_H__
+#define __RINGBUF_SHM_H__
+
+/**
+ * @file ringbuf_shm.h Single-producer/single-consumer ringbuf living
+ * entirely inside one shared memory segment.
+ *
+ * The control block holds no pointers, only an offset from itself to the
+ * element storage that follows it, so the segment can be mapped at
+ * different addresses in different processes. The producer and consumer
+ * may be in separate processes and hand elements over in place, without
+ * system calls. For the same reason there are no ops callbacks; elements
+ * are copied with memcpy.
+ *
+ * Backed by a regular file (ringbuf_shm_open_file) the ringbuf is also
+ * persistent: ringbuf_shm_sync_tail/ringbuf_shm_sync_head flush elements
+ * and indices to the file in order, and a restarted process reattaches in
+ * O(1) at the last synced positions.
+ */
+
+#include <stdint.h>
+
+#include "ringbuf.h"
+
+/** ringbuf_shm magic number, 'RBSH' */
+#define RINGBUF_SHM_MAGIC 0x52425348u
+/** ringbuf_shm layout version */
+#define RINGBUF_SHM_VERSION 2u
+
+/** ringbuf_shm flags */
+/**
+ * Persistent file backed ringbuf: the producer only reuses slots released
+ * by ringbuf_shm_sync_head, so synced elements are never overwritten, and
+ * the consumer only sees elements synced by ringbuf_shm_sync_tail
+ */
+#define RINGBUF_SHM_F_DURABLE (1u << 0)
+
+/**
+ * Control block at the start of the shared segment.
+ */
+struct ringbuf_shm {
+    /** RINGBUF_SHM_MAGIC, written last when formatting */
+    _Atomic uint32_t magic;
+    /** RINGBUF_SHM_VERSION */
+    uint32_t version;
+    /** Maximum number of elements that can be stored, a power of two */
+    uint64_t capacity;
+    /** Size of each element (bytes) */
+    uint64_t elem_sz;
+    /** Offset (bytes) from the start of this struct to the element storage */
+    uint64_t data_off;
+    /** Total segment size (bytes) */
+    uint64_t seg_sz;
+    /** RINGBUF_SHM_F_* flags */
+    uint64_t flags;
+
+    /** Tail index, written only by the producer */
+    _Alignas(RINGBUF_CACHELINE) _Atomic uint64_t tail;
+    /** Producer's cached copy of head */
+    uint64_t head_cache;
+    /** Tail index last flushed to the file, with all elements before it */
+    _Atomic uint64_t sync_tail;
+
+    /** Head index, written only by the consumer */
+    _Alignas(RINGBUF_CACHELINE) _Atomic uint64_t head;
+    /** Consumer's cached copy of tail */
+    uint64_t tail_cache;
+    /** Head index last flushed to the file */
+    _Atomic uint64_t sync_head;
+    /** With RINGBUF_SHM_F_DURABLE, the producer reuses slots up to here */
+    _Atomic uint64_t reuse_head;
+};
+
+size_t ringbuf_shm_size(size_t n_elem, size_t elem_sz);
+struct ringbuf_shm *ringbuf_shm_format(void *mem, size_t mem_sz, size_t n_elem, size_t elem_sz);
+struct ringbuf_shm *ringbuf_shm_attach(void *mem, size_t mem_sz);
+struct ringbuf_shm *ringbuf_shm_create(const char *name, size_t n_elem, size_t elem_sz);
+struct ringbuf_shm *ringbuf_shm_open(const char *name);
+void ringbuf_shm_close(struct ringbuf_shm *rb);
+struct ringbuf_shm *ringbuf_shm_open_file(const char *path, size_t n_elem, size_t elem_sz);
+int ringbuf_shm_sync_tail(struct ringbuf_shm *rb);
+int ringbuf_shm_sync_head(struct ringbuf_shm *rb);
+
+size_t ringbuf_shm_count(const struct ringbuf_shm *rb);
+int ringbuf_shm_add_tail(struct ringbuf_shm *rb, const void *elem);
+int ringbuf_shm_remove_head(struct ringbuf_shm *rb, void *elem);
+void *ringbuf_shm_reserve_tail(struct ringbuf_shm *rb);
+int ringbuf_shm_commit_tail(struct ringbuf_shm *rb);
+void *ringbuf_shm_peek_head(struct ringbuf_shm *rb);
+int ringbuf_shm_release_head(struct ringbuf_shm *rb);
+
+#endif
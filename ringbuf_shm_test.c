@@ -0,0 +1,256 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_shm_test.c Example usage for the shared memory ringbuf.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ringbuf_shm.h"
+
+#define ELEMS_BUF_LEN 8
+#define N_ITEMS 100000
+
+struct my_struct {
+    int id;
+    char name[16];
+};
+
+static void test_shm_format_attach(void)
+{
+    size_t sz = ringbuf_shm_size(ELEMS_BUF_LEN, sizeof(int));
+    struct ringbuf_shm *rb;
+    void *mem;
+    int my_elem;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    // aligned_alloc needs a size that is a multiple of the alignment
+    mem = aligned_alloc(RINGBUF_CACHELINE,
+            (sz + RINGBUF_CACHELINE - 1) & ~(size_t)(RINGBUF_CACHELINE - 1));
+    assert(mem);
+    memset(mem, 0, sz);
+
+    assert(NULL == ringbuf_shm_attach(mem, sz)); // not formatted
+    assert(NULL == ringbuf_shm_format(mem, sz, ELEMS_BUF_LEN - 1, sizeof(int)));
+    assert(NULL == ringbuf_shm_format(mem, sz - 1, ELEMS_BUF_LEN, sizeof(int)));
+    rb = ringbuf_shm_format(mem, sz, ELEMS_BUF_LEN, sizeof(int));
+    assert(rb == mem);
+    assert(rb == ringbuf_shm_attach(mem, sz));
+    assert(NULL == ringbuf_shm_attach(mem, sz - 1));
+
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == ringbuf_shm_add_tail(rb, &i));
+        }
+        assert(-1 == ringbuf_shm_add_tail(rb, &my_elem));
+        assert(ELEMS_BUF_LEN == ringbuf_shm_count(rb));
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == ringbuf_shm_remove_head(rb, &my_elem));
+            assert(my_elem == i);
+        }
+        assert(-1 == ringbuf_shm_remove_head(rb, &my_elem));
+    }
+
+    // element storage lies entirely within the segment
+    assert((char *)ringbuf_shm_reserve_tail(rb) >= (char *)mem + sizeof(*rb));
+    assert((char *)ringbuf_shm_reserve_tail(rb) + sizeof(int) <= (char *)mem + sz);
+
+    free(mem);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+// producer in a child process, consumer in the parent, each with its own
+// mapping of the segment
+static void test_shm_processes(void)
+{
+    struct ringbuf_shm *rb;
+    struct my_struct *p;
+    char name[64];
+    size_t page;
+    int status, fd;
+    pid_t pid;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    snprintf(name, sizeof(name), "/ringbuf_shm_test_%d", (int)getpid());
+    rb = ringbuf_shm_create(name, ELEMS_BUF_LEN, sizeof(struct my_struct));
+    assert(rb);
+    assert(NULL == ringbuf_shm_create(name, ELEMS_BUF_LEN, sizeof(struct my_struct)));
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        struct ringbuf_shm *crb = ringbuf_shm_open(name);
+
+        if (!crb) {
+            _exit(1);
+        }
+        for (int i = 0; i < N_ITEMS; i++) {
+            while ((p = ringbuf_shm_reserve_tail(crb)) == NULL) {
+                sched_yield();
+            }
+            p->id = i;
+            snprintf(p->name, sizeof(p->name), "name_%d", i);
+            ringbuf_shm_commit_tail(crb);
+        }
+        ringbuf_shm_close(crb);
+        _exit(0);
+    }
+
+    for (int i = 0; i < N_ITEMS; i++) {
+        char expect[16];
+
+        while ((p = ringbuf_shm_peek_head(rb)) == NULL) {
+            sched_yield();
+        }
+        snprintf(expect, sizeof(expect), "name_%d", i);
+        assert(p->id == i && 0 == strcmp(p->name, expect));
+        assert(0 == ringbuf_shm_release_head(rb));
+    }
+
+    assert(pid == waitpid(pid, &status, 0));
+    assert(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+    assert(0 == ringbuf_shm_count(rb));
+    ringbuf_shm_close(rb);
+
+    // a segment larger than the ringbuf only stays mapped up to seg_sz
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    fd = shm_open(name, O_RDWR, 0);
+    assert(fd >= 0);
+    assert(0 == ftruncate(fd, 4 * page));
+    close(fd);
+    rb = ringbuf_shm_open(name);
+    assert(rb && rb->seg_sz <= page);
+    assert(-1 == msync((char *)rb + page, page, MS_ASYNC) && errno == ENOMEM);
+    ringbuf_shm_close(rb);
+    assert(0 == shm_unlink(name));
+    assert(NULL == ringbuf_shm_open(name));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_shm_file_persist(void)
+{
+    char path[] = "/tmp/ringbuf_shm_test_XXXXXX";
+    struct ringbuf_shm *rb;
+    int my_elem, fd;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    unlink(path);
+
+    assert(NULL == ringbuf_shm_open_file(path, ELEMS_BUF_LEN - 1, sizeof(int)));
+    rb = ringbuf_shm_open_file(path, ELEMS_BUF_LEN, sizeof(int));
+    assert(rb && (rb->flags & RINGBUF_SHM_F_DURABLE));
+
+    // 0..5 synced, 6..7 added after the last sync
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == ringbuf_shm_add_tail(rb, &i));
+        if (i == 5) {
+            assert(0 == ringbuf_shm_sync_tail(rb));
+        }
+    }
+    assert(-1 == ringbuf_shm_add_tail(rb, &my_elem));
+
+    // released slots are reused only once the release is synced
+    assert(0 == ringbuf_shm_remove_head(rb, &my_elem) && my_elem == 0);
+    assert(0 == ringbuf_shm_remove_head(rb, &my_elem) && my_elem == 1);
+    assert(-1 == ringbuf_shm_add_tail(rb, &my_elem));
+    assert(0 == ringbuf_shm_sync_head(rb));
+    assert(0 == ringbuf_shm_remove_head(rb, &my_elem) && my_elem == 2); // not synced
+    my_elem = 100;
+    assert(0 == ringbuf_shm_add_tail(rb, &my_elem)); // not synced
+    ringbuf_shm_close(rb); // "crash"
+
+    // header is validated against the expected geometry
+    assert(NULL == ringbuf_shm_open_file(path, ELEMS_BUF_LEN, sizeof(long long)));
+    assert(EINVAL == errno);
+    assert(NULL == ringbuf_shm_open_file(path, ELEMS_BUF_LEN * 2, sizeof(int)));
+
+    // reattach at the synced positions: 2..5, 2 is redelivered
+    rb = ringbuf_shm_open_file(path, ELEMS_BUF_LEN, sizeof(int));
+    assert(rb);
+    assert(4 == ringbuf_shm_count(rb));
+    for (int i = 2; i < 6; i++) {
+        assert(0 == ringbuf_shm_remove_head(rb, &my_elem) && my_elem == i);
+    }
+    assert(-1 == ringbuf_shm_remove_head(rb, &my_elem));
+    assert(0 == ringbuf_shm_sync_head(rb));
+
+    // consuming before the producer syncs: unsynced adds stay invisible, so
+    // sync_head never passes sync_tail and the file still opens
+    for (int i = 0; i < 3; i++) {
+        assert(0 == ringbuf_shm_add_tail(rb, &i));
+    }
+    assert(-1 == ringbuf_shm_remove_head(rb, &my_elem));
+    assert(0 == ringbuf_shm_sync_head(rb));
+    ringbuf_shm_close(rb);
+    rb = ringbuf_shm_open_file(path, ELEMS_BUF_LEN, sizeof(int));
+    assert(rb && 0 == ringbuf_shm_count(rb));
+    for (int i = 0; i < 3; i++) {
+        assert(0 == ringbuf_shm_add_tail(rb, &i));
+    }
+    assert(0 == ringbuf_shm_sync_tail(rb));
+    for (int i = 0; i < 3; i++) {
+        assert(0 == ringbuf_shm_remove_head(rb, &my_elem) && my_elem == i);
+    }
+    assert(0 == ringbuf_shm_sync_head(rb));
+    ringbuf_shm_close(rb);
+    rb = ringbuf_shm_open_file(path, ELEMS_BUF_LEN, sizeof(int));
+    assert(rb && 0 == ringbuf_shm_count(rb));
+
+    // wrap around the end of the file
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == ringbuf_shm_add_tail(rb, &i));
+        }
+        assert(0 == ringbuf_shm_sync_tail(rb));
+        for (int i = 0; i < ELEMS_BUF_LEN / 2; i++) {
+            assert(0 == ringbuf_shm_remove_head(rb, &my_elem) && my_elem == i);
+        }
+        assert(0 == ringbuf_shm_sync_head(rb));
+        ringbuf_shm_close(rb);
+        rb = ringbuf_shm_open_file(path, ELEMS_BUF_LEN, sizeof(int));
+        assert(rb && ELEMS_BUF_LEN / 2 == ringbuf_shm_count(rb));
+        for (int i = ELEMS_BUF_LEN / 2; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == ringbuf_shm_remove_head(rb, &my_elem) && my_elem == i);
+        }
+        assert(0 == ringbuf_shm_sync_head(rb));
+    }
+    ringbuf_shm_close(rb);
+
+    // a corrupted header is rejected
+    fd = open(path, O_WRONLY);
+    assert(fd >= 0);
+    assert(1 == write(fd, "X", 1));
+    close(fd);
+    assert(NULL == ringbuf_shm_open_file(path, ELEMS_BUF_LEN, sizeof(int)));
+    assert(0 == unlink(path));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_shm_format_attach();
+    test_shm_processes();
+    test_shm_file_persist();
+
+    return 0;
+}
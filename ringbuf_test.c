@@ -7,9 +7,14 @@
  * @file ringbuf_test.c Example usage for a simple ringbuf implementation.
  */
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "ringbuf.h"
 
@@ -23,10 +28,15 @@ struct my_struct {
     char name[16];
 };
 
+RINGBUF_DECLARE(char_queue, char, ELEMS_BUF_LEN)
+RINGBUF_DECLARE(int_queue, int, ELEMS_BUF_LEN)
+RINGBUF_DECLARE(my_struct_queue, struct my_struct, ELEMS_BUF_LEN)
+
 static void ringbuf_print_stats(const struct ringbuf *rb)
 {
     printf("ringbuf @ %p: buf=%p elem_sz=%zu head=%zu tail=%zu count=%zu capacity=%zu empty=%s full=%s\n",
-            rb, rb->buf, rb->elem_sz, rb->head, rb->tail, rb->count, rb->capacity,
+            rb, rb->buf, rb->elem_sz, atomic_load(&rb->head), atomic_load(&rb->tail),
+            ringbuf_count(rb), rb->capacity,
             ringbuf_empty(rb) ? "yes" : "no",
             ringbuf_full(rb) ? "yes" : "no");
 }
@@ -71,6 +81,16 @@ static void copy_my_struct(void *dst, const void *src)
     snprintf(dst_elem->name, sizeof(dst_elem->name), "%s", src_elem->name);
 }
 
+static int copy_my_struct_n_calls;
+
+static void copy_my_struct_n(void *dst, const void *src, size_t n)
+{
+    copy_my_struct_n_calls++;
+    for (size_t i = 0; i < n; i++) {
+        copy_my_struct((struct my_struct *)dst + i, (const struct my_struct *)src + i);
+    }
+}
+
 static void test_queue_char(void)
 {
     char buf[ELEMS_BUF_LEN];
@@ -244,12 +264,950 @@ static void test_queue_my_struct_malloc(void)
     printf("==== %s END ====\n", __FUNCTION__);
 }
 
+#define SPSC_N_ITEMS 200000
+
+static void *spsc_producer(void *arg)
+{
+    struct ringbuf *rb = arg;
+
+    for (int i = 0; i < SPSC_N_ITEMS; i++) {
+        while (queue_add(rb, &i) < 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// One producer thread and one consumer thread sharing a ringbuf without
+// any locking. Elements must come out complete and in order.
+static void test_queue_spsc_threads(size_t n_elem)
+{
+    int buf[ELEMS_BUF_LEN];
+    struct ringbuf rb;
+    pthread_t producer;
+    int my_elem;
+
+    printf("==== %s(%zu) START ====\n", __FUNCTION__, n_elem);
+
+    assert(n_elem <= ELEMS_BUF_LEN);
+    assert(0 == ringbuf_init(&rb, (void*)&buf, n_elem, sizeof(buf[0])));
+    assert(0 == pthread_create(&producer, NULL, spsc_producer, &rb));
+
+    for (int i = 0; i < SPSC_N_ITEMS; i++) {
+        while (queue_remove(&rb, &my_elem) < 0) {
+            sched_yield();
+        }
+        assert(my_elem == i);
+    }
+
+    assert(0 == pthread_join(producer, NULL));
+    assert(ringbuf_empty(&rb));
+    ringbuf_print_stats(&rb);
+
+    printf("==== %s(%zu) END ====\n", __FUNCTION__, n_elem);
+}
+
+static void test_queue_pow2(void)
+{
+    int buf[ELEMS_BUF_LEN];
+    struct ringbuf rb;
+    int my_elem;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_init_flags(&rb, (void*)&buf, ELEMS_BUF_LEN - 1, sizeof(buf[0]),
+                RINGBUF_F_POW2));
+    assert(-1 == ringbuf_init_flags(&rb, (void*)&buf, 0, sizeof(buf[0]), RINGBUF_F_POW2));
+    assert(0 == ringbuf_init(&rb, (void*)&buf, ELEMS_BUF_LEN - 1, sizeof(buf[0])));
+    assert(!(rb.flags & RINGBUF_F_POW2));
+    assert(0 == ringbuf_init_flags(&rb, (void*)&buf, ELEMS_BUF_LEN, sizeof(buf[0]),
+                RINGBUF_F_POW2));
+
+    // start the free running indices just below the size_t wrap point
+    atomic_store(&rb.head, (size_t)-3);
+    atomic_store(&rb.tail, (size_t)-3);
+    rb.head_cache = rb.tail_cache = (size_t)-3;
+
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            my_elem = round * 100 + i;
+            assert(0 == queue_add(&rb, &my_elem));
+        }
+        assert(ringbuf_full(&rb));
+        assert(-1 == queue_add(&rb, &my_elem));
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == queue_remove(&rb, &my_elem));
+            assert(my_elem == round * 100 + i);
+        }
+        assert(ringbuf_empty(&rb));
+    }
+    ringbuf_print_stats(&rb);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_queue_bulk(void)
+{
+    int buf[ELEMS_BUF_LEN - 1];
+    int in[3 * ELEMS_BUF_LEN], out[3 * ELEMS_BUF_LEN];
+    struct my_struct sbuf[ELEMS_BUF_LEN], sin[ELEMS_BUF_LEN], sout[ELEMS_BUF_LEN];
+    struct ringbuf rb;
+    int next_in = 0, next_out = 0;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    for (int i = 0; i < 3 * ELEMS_BUF_LEN; i++) {
+        in[i] = i;
+    }
+
+    assert(0 == ringbuf_init(&rb, (void*)&buf, ELEMS_BUF_LEN - 1, sizeof(buf[0])));
+    rb.ops.elem_print = &elem_print_int;
+
+    assert(0 == ringbuf_add_tail_n(&rb, NULL, 3));
+    assert(0 == ringbuf_remove_head_n(&rb, out, 3)); // empty
+
+    // uneven batch sizes so that runs split across the wrap point
+    for (int round = 0; round < 6; round++) {
+        size_t n = ringbuf_add_tail_n(&rb, &in[next_in], 5);
+        assert(n == (size_t)(ELEMS_BUF_LEN - 1) - (next_in - next_out) || n == 5);
+        next_in += n;
+        n = ringbuf_remove_head_n(&rb, out, 3);
+        assert(n == 3);
+        for (size_t i = 0; i < n; i++) {
+            assert(out[i] == next_out++);
+        }
+    }
+    assert((size_t)(next_in - next_out) == ringbuf_count(&rb));
+    assert((size_t)(next_in - next_out) == ringbuf_remove_head_n(&rb, NULL, 3 * ELEMS_BUF_LEN));
+    assert(ringbuf_empty(&rb));
+    ringbuf_print_stats(&rb);
+
+    // bulk transfers still go through ops.elem_copy
+    assert(0 == ringbuf_init(&rb, (void*)&sbuf, ELEMS_BUF_LEN, sizeof(sbuf[0])));
+    rb.ops.elem_copy = &copy_my_struct;
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        sin[i].id = 100 + i;
+        snprintf(sin[i].name, sizeof(sin[i].name), "name_%d", i);
+    }
+    assert(3 == ringbuf_add_tail_n(&rb, sin, 3));
+    assert(3 == ringbuf_remove_head_n(&rb, sout, ELEMS_BUF_LEN));
+    assert(ELEMS_BUF_LEN == ringbuf_add_tail_n(&rb, sin, ELEMS_BUF_LEN));
+    assert(0 == ringbuf_add_tail_n(&rb, sin, 1)); // full
+    assert(ELEMS_BUF_LEN == ringbuf_remove_head_n(&rb, sout, ELEMS_BUF_LEN));
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(sout[i].id == sin[i].id && 0 == strcmp(sout[i].name, sin[i].name));
+    }
+    ringbuf_print_stats(&rb);
+
+    // elem_copy_n is called once per contiguous run instead
+    copy_my_struct_n_calls = 0;
+    rb.ops.elem_copy_n = &copy_my_struct_n;
+    assert(3 == ringbuf_add_tail_n(&rb, sin, 3));
+    assert(1 == copy_my_struct_n_calls);
+    assert(3 == ringbuf_remove_head_n(&rb, sout, 3));
+    assert(2 == copy_my_struct_n_calls);
+    assert(6 == ringbuf_add_tail_n(&rb, sin, 6)); // wraps
+    assert(4 == copy_my_struct_n_calls);
+    assert(0 == ringbuf_remove_head(&rb, sout)); // single elements too
+    assert(5 == copy_my_struct_n_calls);
+    assert(5 == ringbuf_remove_head_n(&rb, &sout[1], 5)); // wraps
+    assert(7 == copy_my_struct_n_calls);
+    for (int i = 0; i < 6; i++) {
+        assert(sout[i].id == sin[i].id && 0 == strcmp(sout[i].name, sin[i].name));
+    }
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_queue_zero_copy(void)
+{
+    struct my_struct buf[ELEMS_BUF_LEN - 2];
+    struct ringbuf rb;
+    struct my_struct *p;
+    size_t n;
+    int next_in = 0, next_out = 0;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_init(&rb, (void*)&buf, ELEMS_BUF_LEN - 2, sizeof(buf[0])));
+    assert(NULL == ringbuf_peek_head(&rb));
+    assert(-1 == ringbuf_release_head(&rb));
+
+    // build elements directly in the backing array
+    while ((p = ringbuf_reserve_tail(&rb)) != NULL) {
+        p->id = next_in++;
+        snprintf(p->name, sizeof(p->name), "name_%d", p->id);
+        assert(0 == ringbuf_commit_tail(&rb));
+    }
+    assert(ringbuf_full(&rb));
+    assert(-1 == ringbuf_commit_tail(&rb));
+
+    p = ringbuf_peek_head(&rb);
+    assert(p == &buf[0] && p->id == next_out++);
+    assert(0 == ringbuf_release_head(&rb));
+
+    // spans stop at the wrap point
+    for (int round = 0; round < 4; round++) {
+        p = ringbuf_reserve_tail_span(&rb, &n);
+        assert(p && n > 0);
+        for (size_t i = 0; i < n; i++) {
+            p[i].id = next_in++;
+        }
+        assert(0 == ringbuf_commit_tail_n(&rb, n));
+
+        p = ringbuf_peek_head_span(&rb, &n);
+        assert(p && n > 0 && p + n <= buf + ELEMS_BUF_LEN - 2);
+        for (size_t i = 0; i < n; i++) {
+            assert(p[i].id == next_out++);
+        }
+        assert(-1 == ringbuf_release_head_n(&rb, ringbuf_count(&rb) + 1));
+        assert(0 == ringbuf_release_head_n(&rb, n));
+    }
+    assert((size_t)(next_in - next_out) == ringbuf_count(&rb));
+    ringbuf_print_stats(&rb);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_queue_scrub(void)
+{
+    int buf[ELEMS_BUF_LEN];
+    struct ringbuf rb;
+    int my_elem = 42;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    // removed slots are left alone by default
+    memset(buf, 0, sizeof(buf));
+    assert(0 == ringbuf_init(&rb, (void*)&buf, ELEMS_BUF_LEN, sizeof(buf[0])));
+    assert(0 == queue_add(&rb, &my_elem));
+    assert(0 == queue_remove(&rb, NULL));
+    assert(42 == buf[0]);
+
+    assert(0 == ringbuf_init_flags(&rb, (void*)&buf, ELEMS_BUF_LEN, sizeof(buf[0]),
+                RINGBUF_F_POW2 | RINGBUF_F_SCRUB));
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == queue_add(&rb, &my_elem));
+    }
+    assert(0 == queue_remove(&rb, &my_elem));
+    assert(42 == my_elem && 0 == buf[0]);
+    assert(0 == ringbuf_release_head(&rb));
+    assert(0 == buf[1]);
+    assert(ELEMS_BUF_LEN - 2 == ringbuf_remove_head_n(&rb, NULL, ELEMS_BUF_LEN));
+    ringbuf_hex_dump(&rb);
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == buf[i]);
+    }
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+// config, producer and consumer state must not share cache lines
+static void test_struct_layout(void)
+{
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(offsetof(struct ringbuf, tail) >= sizeof(((struct ringbuf *)0)->ops) +
+            offsetof(struct ringbuf, ops));
+    assert(0 == offsetof(struct ringbuf, tail) % RINGBUF_CACHELINE);
+    assert(0 == offsetof(struct ringbuf, head) % RINGBUF_CACHELINE);
+    assert(offsetof(struct ringbuf, head) - offsetof(struct ringbuf, tail) >= RINGBUF_CACHELINE);
+    assert(offsetof(struct ringbuf, head_cache) < offsetof(struct ringbuf, head));
+    assert(0 == sizeof(struct ringbuf) % RINGBUF_CACHELINE);
+    printf("sizeof(struct ringbuf)=%zu tail@%zu head@%zu\n", sizeof(struct ringbuf),
+            offsetof(struct ringbuf, tail), offsetof(struct ringbuf, head));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_queue_declared(void)
+{
+    struct char_queue cq;
+    struct int_queue iq;
+    struct my_struct_queue sq;
+    struct my_struct my_elem = {0};
+    char c;
+    int n;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    char_queue_init(&cq);
+    int_queue_init(&iq);
+    my_struct_queue_init(&sq);
+
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            c = 'a' + i;
+            n = round * 100 + i;
+            my_elem.id = n;
+            snprintf(my_elem.name, sizeof(my_elem.name), "name_%d", n);
+            assert(0 == char_queue_add_tail(&cq, &c));
+            assert(0 == int_queue_add_tail(&iq, &n));
+            assert(0 == my_struct_queue_add_tail(&sq, &my_elem));
+        }
+        assert(char_queue_full(&cq) && int_queue_full(&iq) && my_struct_queue_full(&sq));
+        assert(-1 == char_queue_add_tail(&cq, &c));
+        assert(-1 == int_queue_add_tail(&iq, &n));
+        assert(-1 == my_struct_queue_add_tail(&sq, &my_elem));
+
+        assert(0 == int_queue_remove_head(&iq, NULL));
+        assert(ELEMS_BUF_LEN - 1 == int_queue_count(&iq));
+        assert(0 == char_queue_remove_head(&cq, &c) && c == 'a');
+        for (int i = 1; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == char_queue_remove_head(&cq, &c) && c == 'a' + i);
+            assert(0 == int_queue_remove_head(&iq, &n) && n == round * 100 + i);
+        }
+        for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+            assert(0 == my_struct_queue_remove_head(&sq, &my_elem));
+            assert(my_elem.id == round * 100 + i);
+        }
+        assert(char_queue_empty(&cq) && int_queue_empty(&iq) && my_struct_queue_empty(&sq));
+        assert(-1 == int_queue_remove_head(&iq, &n));
+    }
+    printf("last elem: ");
+    elem_print_my_struct(&my_elem);
+    printf("\n");
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+#define WAIT_N_ITEMS 2000
+
+static void *wait_producer(void *arg)
+{
+    struct ringbuf *rb = arg;
+
+    for (int i = 0; i < WAIT_N_ITEMS; i++) {
+        assert(0 == ringbuf_add_tail_wait(rb, &i, -1));
+        if (i % 500 == 0) {
+            usleep(10000); // let the consumer park
+        }
+    }
+    return NULL;
+}
+
+static long long elapsed_ms(const struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) * 1000LL + (t1.tv_nsec - t0->tv_nsec) / 1000000;
+}
+
+static void test_queue_wait(void)
+{
+    int buf[ELEMS_BUF_LEN];
+    struct ringbuf rb;
+    struct ringbuf_stats st;
+    struct timespec t0;
+    pthread_t producer;
+    int my_elem;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    // without RINGBUF_F_WAIT nobody would wake us: fail instead of hanging
+    assert(0 == ringbuf_init(&rb, (void*)&buf, ELEMS_BUF_LEN, sizeof(buf[0])));
+    assert(-1 == ringbuf_remove_head_wait(&rb, &my_elem, -1));
+    assert(-1 == ringbuf_add_tail_wait(&rb, &my_elem, -1));
+
+    assert(0 == ringbuf_init_flags(&rb, (void*)&buf, ELEMS_BUF_LEN, sizeof(buf[0]),
+                RINGBUF_F_POW2 | RINGBUF_F_WAIT));
+
+    // timeouts on empty and full; the polling does not count as failed ops
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    assert(-1 == ringbuf_remove_head_wait(&rb, &my_elem, 20));
+    assert(elapsed_ms(&t0) >= 20);
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(0 == ringbuf_add_tail_wait(&rb, &i, 0));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    assert(-1 == ringbuf_add_tail_wait(&rb, &my_elem, 20));
+    assert(elapsed_ms(&t0) >= 20);
+    ringbuf_stats_snapshot(&rb, &st);
+    assert(0 == st.empty && 0 == st.full);
+    assert(ELEMS_BUF_LEN == ringbuf_remove_head_n(&rb, NULL, ELEMS_BUF_LEN));
+
+    // producer blocks on full, consumer blocks on empty
+    assert(0 == pthread_create(&producer, NULL, wait_producer, &rb));
+    for (int i = 0; i < WAIT_N_ITEMS; i++) {
+        assert(0 == ringbuf_remove_head_wait(&rb, &my_elem, -1));
+        assert(my_elem == i);
+        if (i % 700 == 0) {
+            usleep(10000); // let the producer park
+        }
+    }
+    assert(0 == pthread_join(producer, NULL));
+    assert(ringbuf_empty(&rb));
+    assert(0 == atomic_load(&rb.cons_waiting) && 0 == atomic_load(&rb.prod_waiting));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_queue_mirrored(void)
+{
+    struct ringbuf rb;
+    struct my_struct in[ELEMS_BUF_LEN], out[ELEMS_BUF_LEN];
+    struct my_struct *p;
+    size_t n, cap;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    // the flag describes the mapping, a plain buffer cannot claim it
+    assert(-1 == ringbuf_init_flags(&rb, in, ELEMS_BUF_LEN, sizeof(in[0]), RINGBUF_F_MIRRORED));
+    // sizes that overflow, before or after rounding up to whole pages
+    assert(-1 == ringbuf_init_mirrored(&rb, SIZE_MAX / 8, 16, 0));
+    assert(-1 == ringbuf_init_mirrored(&rb, SIZE_MAX, 1, 0));
+    assert(-1 == ringbuf_init_mirrored(&rb, SIZE_MAX / 2, 1, 0));
+
+    // 20 byte elements: capacity is rounded up to fill whole pages
+    assert(0 == ringbuf_init_mirrored(&rb, 1000, sizeof(struct my_struct), 0));
+    cap = rb.capacity;
+    assert(cap >= 1000 && 0 == (cap * rb.elem_sz) % sysconf(_SC_PAGESIZE));
+    assert(rb.flags & RINGBUF_F_MIRRORED);
+    ringbuf_print_stats(&rb);
+
+    // both halves of the mapping alias the same storage
+    p = (struct my_struct *)rb.buf;
+    p[cap].id = 1234;
+    assert(p[0].id == 1234);
+
+    // move head and tail close to the end of the storage
+    assert(0 == ringbuf_commit_tail_n(&rb, cap - 3));
+    assert(0 == ringbuf_release_head_n(&rb, cap - 3));
+
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        in[i].id = i;
+        snprintf(in[i].name, sizeof(in[i].name), "name_%d", i);
+    }
+    // a reserved span runs straight through the wrap point
+    p = ringbuf_reserve_tail_span(&rb, &n);
+    assert(p && n == cap);
+    memcpy(p, in, sizeof(in));
+    assert(0 == ringbuf_commit_tail_n(&rb, ELEMS_BUF_LEN));
+
+    p = ringbuf_peek_head_span(&rb, &n);
+    assert(p && n == ELEMS_BUF_LEN);
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        assert(p[i].id == i);
+    }
+    assert(ELEMS_BUF_LEN == ringbuf_remove_head_n(&rb, out, ELEMS_BUF_LEN));
+    assert(0 == memcmp(in, out, sizeof(in)));
+
+    ringbuf_free_mirrored(&rb);
+    assert(NULL == rb.buf);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_queue_overwrite(void)
+{
+    int buf[ELEMS_BUF_LEN], in[3 * ELEMS_BUF_LEN], out[ELEMS_BUF_LEN];
+    struct ringbuf rb;
+    size_t n;
+    int *p;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_init_flags(&rb, buf, ELEMS_BUF_LEN - 1, sizeof(buf[0]),
+                RINGBUF_F_OVERWRITE));
+    assert(-1 == ringbuf_init_flags(&rb, buf, ELEMS_BUF_LEN, sizeof(buf[0]),
+                RINGBUF_F_OVERWRITE | RINGBUF_F_SCRUB));
+    assert(0 == ringbuf_init_flags(&rb, buf, ELEMS_BUF_LEN, sizeof(buf[0]),
+                RINGBUF_F_OVERWRITE));
+    assert(rb.flags & RINGBUF_F_POW2);
+
+    // a full ringbuf keeps accepting, only the newest elements survive
+    for (int i = 0; i < 20; i++) {
+        assert(0 == ringbuf_add_tail(&rb, &i));
+    }
+    assert(ringbuf_full(&rb));
+    assert(20 - ELEMS_BUF_LEN == ringbuf_dropped(&rb));
+    for (int i = 20 - ELEMS_BUF_LEN; i < 20; i++) {
+        assert(0 == ringbuf_remove_head(&rb, out));
+        assert(out[0] == i);
+    }
+    assert(-1 == ringbuf_remove_head(&rb, out));
+
+    // a batch larger than the ringbuf replaces everything in it
+    for (int i = 0; i < 3 * ELEMS_BUF_LEN; i++) {
+        in[i] = 100 + i;
+    }
+    assert(3 == ringbuf_add_tail_n(&rb, in, 3));
+    assert(3 * ELEMS_BUF_LEN == ringbuf_add_tail_n(&rb, in, 3 * ELEMS_BUF_LEN));
+    assert(20 - ELEMS_BUF_LEN + 3 + 2 * ELEMS_BUF_LEN == ringbuf_dropped(&rb));
+    assert(ELEMS_BUF_LEN == ringbuf_remove_head_n(&rb, out, ELEMS_BUF_LEN));
+    assert(0 == memcmp(out, &in[2 * ELEMS_BUF_LEN], sizeof(out)));
+
+    // a peeked element that gets overwritten cannot be released
+    assert(ELEMS_BUF_LEN == ringbuf_add_tail_n(&rb, in, ELEMS_BUF_LEN));
+    p = ringbuf_peek_head_span(&rb, &n);
+    assert(p && n >= 1 && *p == in[0]);
+    assert(0 == ringbuf_add_tail(&rb, &in[ELEMS_BUF_LEN]));
+    assert(-1 == ringbuf_release_head(&rb));
+    assert(1 == atomic_load(&rb.lapped));
+    p = ringbuf_peek_head_span(&rb, &n);
+    assert(p && *p == in[1]);
+    assert(0 == ringbuf_release_head_n(&rb, 2));
+    assert(ELEMS_BUF_LEN - 2 == ringbuf_count(&rb));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+// large enough that a copy can be interrupted by the producer part way
+struct seq_elem {
+    unsigned long seq;
+    unsigned long fill[6];
+    unsigned long check;
+};
+
+#define OVERWRITE_N_ITEMS 200000
+
+static void *overwrite_producer(void *arg)
+{
+    struct ringbuf *rb = arg;
+    struct seq_elem e;
+
+    for (unsigned long i = 0; i < OVERWRITE_N_ITEMS; i++) {
+        e.seq = i;
+        for (int j = 0; j < 6; j++) {
+            e.fill[j] = i;
+        }
+        e.check = ~i;
+        assert(0 == ringbuf_add_tail(rb, &e));
+        if (i % 64 == 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// The producer never waits. Whatever the consumer gets must be whole and in
+// order, and nothing may go missing without being counted as dropped.
+static void test_queue_overwrite_threads(void)
+{
+    struct seq_elem buf[ELEMS_BUF_LEN], e;
+    struct ringbuf rb;
+    pthread_t producer;
+    unsigned long consumed = 0, next = 0;
+    size_t left;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_init_flags(&rb, buf, ELEMS_BUF_LEN, sizeof(buf[0]),
+                RINGBUF_F_OVERWRITE));
+    assert(0 == pthread_create(&producer, NULL, overwrite_producer, &rb));
+
+    while (next < OVERWRITE_N_ITEMS) {
+        if (ringbuf_remove_head(&rb, &e) < 0) {
+            sched_yield();
+            continue;
+        }
+        assert(e.seq >= next);
+        assert(e.check == ~e.seq);
+        for (int j = 0; j < 6; j++) {
+            assert(e.fill[j] == e.seq);
+        }
+        next = e.seq + 1;
+        consumed++;
+    }
+
+    assert(0 == pthread_join(producer, NULL));
+    left = ringbuf_count(&rb);
+    assert(0 == left);
+    assert(consumed + ringbuf_dropped(&rb) == OVERWRITE_N_ITEMS);
+    printf("consumed=%lu dropped=%zu lapped=%zu\n", consumed, ringbuf_dropped(&rb),
+            atomic_load(&rb.lapped));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_queue_stats(void)
+{
+    int buf[ELEMS_BUF_LEN], in[ELEMS_BUF_LEN], out[ELEMS_BUF_LEN];
+    struct ringbuf rb;
+    struct ringbuf_stats st;
+    size_t n;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        in[i] = i;
+    }
+    assert(0 == ringbuf_init(&rb, buf, ELEMS_BUF_LEN, sizeof(buf[0])));
+    assert(-1 == ringbuf_remove_head(&rb, out));
+    assert(5 == ringbuf_add_tail_n(&rb, in, 5));
+    assert(3 == ringbuf_remove_head_n(&rb, out, 3));
+    assert(6 == ringbuf_add_tail_n(&rb, in, ELEMS_BUF_LEN)); // falls short, full
+    assert(-1 == ringbuf_add_tail(&rb, in));
+    assert(NULL == ringbuf_reserve_tail_span(&rb, &n));
+    assert(ringbuf_peek_head_span(&rb, &n));
+    assert(0 == ringbuf_release_head_n(&rb, n));
+    assert(0 == ringbuf_add_tail(&rb, in));
+
+    ringbuf_stats_snapshot(&rb, &st);
+    printf("enqueued=%zu dequeued=%zu full=%zu empty=%zu high_water=%zu count=%zu\n",
+            st.enqueued, st.dequeued, st.full, st.empty, st.high_water, st.count);
+    assert(st.count == ELEMS_BUF_LEN - n + 1);
+    assert(0 == st.dropped && 0 == st.lapped);
+#if RINGBUF_STATS
+    assert(st.enqueued == 12);
+    assert(st.dequeued == 3 + n);
+    assert(st.full == 3);
+    assert(st.empty == 1);
+    assert(st.high_water == ELEMS_BUF_LEN);
+#else
+    assert(0 == st.enqueued && 0 == st.dequeued && 0 == st.high_water);
+#endif
+
+    // producer and consumer counters do not share a cache line
+    assert(offsetof(struct ringbuf, stat_enqueued) / RINGBUF_CACHELINE ==
+            offsetof(struct ringbuf, tail) / RINGBUF_CACHELINE);
+    assert(offsetof(struct ringbuf, stat_dequeued) / RINGBUF_CACHELINE ==
+            offsetof(struct ringbuf, head) / RINGBUF_CACHELINE);
+    assert(offsetof(struct ringbuf, stat_cons_waits) / RINGBUF_CACHELINE ==
+            offsetof(struct ringbuf, head) / RINGBUF_CACHELINE);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+#define LARGE_ELEM_SZ 4096
+
+// Large elements with RINGBUF_F_NT go through the streaming copy kernels. Check data survives
+// single and bulk copies across the wrap point, with aligned and unaligned
+// storage (which must fall back to plain copies).
+static void test_queue_large_elems(void)
+{
+    struct ringbuf rb;
+    char *buf, *in, *out;
+    const size_t n_elem = 4;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    buf = aligned_alloc(64, (n_elem + 1) * LARGE_ELEM_SZ);
+    in = malloc(3 * LARGE_ELEM_SZ);
+    out = malloc(3 * LARGE_ELEM_SZ);
+    assert(buf && in && out);
+    for (size_t i = 0; i < 3 * LARGE_ELEM_SZ; i++) {
+        in[i] = (char)(i * 7 + i / LARGE_ELEM_SZ);
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        // second pass: slots only 8 byte aligned
+        char *storage = buf + (pass ? 8 : 0);
+
+        assert(0 == ringbuf_init(&rb, storage, n_elem, LARGE_ELEM_SZ));
+        assert(0 == strcmp(ringbuf_copy_kernel(&rb), "prefetch"));
+        assert(0 == ringbuf_init_flags(&rb, storage, n_elem, LARGE_ELEM_SZ,
+                    RINGBUF_F_POW2 | RINGBUF_F_NT));
+        printf("copy kernel: %s\n", ringbuf_copy_kernel(&rb));
+        assert(strcmp(ringbuf_copy_kernel(&rb), "memcpy"));
+        if (pass) {
+            assert(0 == strcmp(ringbuf_copy_kernel(&rb), "prefetch"));
+        }
+
+        for (int round = 0; round < 5; round++) {
+            assert(0 == ringbuf_add_tail(&rb, in));
+            assert(3 == ringbuf_add_tail_n(&rb, in, 3));
+            assert(0 == ringbuf_remove_head(&rb, out));
+            assert(0 == memcmp(in, out, LARGE_ELEM_SZ));
+            assert(3 == ringbuf_remove_head_n(&rb, out, 3));
+            assert(0 == memcmp(in, out, 3 * LARGE_ELEM_SZ));
+            assert(0 == ringbuf_add_tail(&rb, in)); // shift the wrap point
+            assert(0 == ringbuf_remove_head(&rb, NULL));
+        }
+        assert(ringbuf_empty(&rb));
+    }
+
+    // small elements keep using memcpy
+    assert(0 == ringbuf_init_flags(&rb, buf, n_elem, 64, RINGBUF_F_NT));
+    assert(0 == strcmp(ringbuf_copy_kernel(&rb), "memcpy"));
+
+    free(out);
+    free(in);
+    free(buf);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+struct count_alloc {
+    size_t live, allocs;
+};
+
+static void *count_alloc(void *ctx, size_t sz)
+{
+    struct count_alloc *ca = ctx;
+
+    ca->live += sz;
+    ca->allocs++;
+    return malloc(sz);
+}
+
+static void count_free(void *ctx, void *p, size_t sz)
+{
+    struct count_alloc *ca = ctx;
+
+    assert(ca->live >= sz);
+    ca->live -= sz;
+    free(p);
+}
+
+static void test_queue_growable(void)
+{
+    struct count_alloc ca = { 0, 0 };
+    const struct ringbuf_allocator alloc = { count_alloc, count_free, &ca };
+    struct ringbuf rb;
+    int in[100], out[100], x;
+    int next_in = 0, next_out = 0;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    for (int i = 0; i < 100; i++) {
+        in[i] = i;
+    }
+    assert(-1 == ringbuf_init_flags(&rb, in, 4, sizeof(int), RINGBUF_F_GROW));
+    assert(-1 == ringbuf_init_growable(&rb, 4, sizeof(int), RINGBUF_F_WAIT, &alloc));
+    assert(0 == ringbuf_init_growable(&rb, 4, sizeof(int), RINGBUF_F_SHRINK, &alloc));
+    assert(1 == ca.allocs && 4 * sizeof(int) == ca.live);
+
+    // move head off slot 0 so the first resize has to relinearize a wrapped run
+    assert(3 == ringbuf_add_tail_n(&rb, in, 3));
+    assert(2 == ringbuf_remove_head_n(&rb, out, 2));
+    next_in = 3;
+    next_out = 2;
+    while (next_in < 50) {
+        assert(0 == ringbuf_add_tail(&rb, &next_in));
+        next_in++;
+    }
+    assert(64 == rb.capacity && 48 == ringbuf_count(&rb));
+    assert(5 == ca.allocs && 64 * sizeof(int) == ca.live);
+
+    // bulk adds grow in one step as far as needed
+    assert(50 == ringbuf_add_tail_n(&rb, &in[50], 50));
+    next_in = 100;
+    assert(128 == rb.capacity && 98 == ringbuf_count(&rb));
+    ringbuf_print_stats(&rb);
+
+    while (next_out < next_in) {
+        assert(0 == ringbuf_remove_head(&rb, &x));
+        assert(x == next_out++);
+    }
+
+    // low occupancy for long enough shrinks back to the initial capacity
+    for (int i = 0; i < 1000; i++) {
+        assert(0 == ringbuf_add_tail(&rb, &i));
+        assert(0 == ringbuf_remove_head(&rb, &x) && x == i);
+    }
+    assert(4 == rb.capacity);
+    assert(4 * sizeof(int) == ca.live);
+
+    // reserving on a full ringbuf grows it too
+    assert(4 == ringbuf_add_tail_n(&rb, in, 4));
+    assert(ringbuf_reserve_tail(&rb) && 8 == rb.capacity);
+    assert(0 == ringbuf_commit_tail(&rb));
+    assert(5 == ringbuf_count(&rb));
+
+    ringbuf_free_growable(&rb);
+    assert(NULL == rb.buf && 0 == ca.live);
+
+    // default allocator, no shrinking
+    assert(0 == ringbuf_init_growable(&rb, 3, sizeof(int), 0, NULL));
+    assert(100 == ringbuf_add_tail_n(&rb, in, 100));
+    assert(192 == rb.capacity);
+    assert(100 == ringbuf_remove_head_n(&rb, out, 100));
+    assert(0 == memcmp(in, out, sizeof(in)));
+    assert(192 == rb.capacity);
+    ringbuf_free_growable(&rb);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+// sum a range of ints the way a windowed reduction would, span by span
+static long sum_range(const struct ringbuf *rb, size_t start, size_t n)
+{
+    struct ringbuf_span spans[2];
+    long sum = 0;
+
+    ringbuf_range(rb, start, n, spans);
+    for (int s = 0; s < 2; s++) {
+        const int *p = spans[s].ptr;
+
+        for (size_t i = 0; i < spans[s].n; i++) {
+            sum += p[i];
+        }
+    }
+    return sum;
+}
+
+static void test_queue_range(void)
+{
+    int buf[ELEMS_BUF_LEN - 1], in[ELEMS_BUF_LEN];
+    struct ringbuf_span spans[2];
+    struct ringbuf rb;
+    const size_t cap = ELEMS_BUF_LEN - 1;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        in[i] = 10 * (i + 1);
+    }
+    assert(0 == ringbuf_init(&rb, buf, cap, sizeof(int)));
+    assert(NULL == ringbuf_at(&rb, 0));
+    assert(0 == ringbuf_range(&rb, 0, cap, spans) && 0 == spans[0].n && 0 == spans[1].n);
+
+    // put the head near the end of the storage so the contents wrap
+    for (size_t shift = 0; shift < 2 * cap; shift++) {
+        assert(cap == ringbuf_add_tail_n(&rb, in, cap));
+        for (size_t i = 0; i < cap; i++) {
+            assert(*(int *)ringbuf_at(&rb, i) == in[i]);
+        }
+        assert(NULL == ringbuf_at(&rb, cap));
+
+        assert(cap == ringbuf_range(&rb, 0, SIZE_MAX, spans));
+        assert(spans[0].ptr == ringbuf_at(&rb, 0));
+        assert(spans[0].n + spans[1].n == cap);
+        assert(spans[1].n == 0 || spans[1].ptr == (void *)buf);
+
+        assert(2 == ringbuf_range(&rb, cap - 2, 5, spans)); // clipped
+        assert(0 == ringbuf_range(&rb, cap + 3, 1, spans));
+        for (size_t start = 0; start < cap; start++) {
+            long expect = 0;
+
+            for (size_t i = start; i < start + 3 && i < cap; i++) {
+                expect += in[i];
+            }
+            assert(sum_range(&rb, start, 3) == expect);
+        }
+
+        assert(cap == ringbuf_remove_head_n(&rb, NULL, cap));
+        assert(0 == ringbuf_add_tail(&rb, in) && 0 == ringbuf_remove_head(&rb, NULL));
+    }
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+#define LAT_BUF_LEN 16
+#define LAT_BIG_LEN 128
+
+static struct ringbuf_latency test_lat;
+#if RINGBUF_TRACE
+static int lat_big[LAT_BIG_LEN], lat_big_in[LAT_BIG_LEN];
+static uint64_t lat_big_stamps[LAT_BIG_LEN];
+#endif
+
+static void test_queue_latency(void)
+{
+    int buf[LAT_BUF_LEN - 1], in[LAT_BUF_LEN], obuf[LAT_BUF_LEN];
+    uint64_t stamps[LAT_BUF_LEN];
+    struct timespec ts = { 0, 2000000 };
+    struct ringbuf rb, grb;
+    struct ringbuf_stats st;
+    size_t n;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    for (int i = 0; i < LAT_BUF_LEN; i++) {
+        in[i] = i;
+    }
+    assert(0 == ringbuf_init(&rb, buf, LAT_BUF_LEN - 1, sizeof(int)));
+#if RINGBUF_TRACE
+    assert(-1 == ringbuf_latency_enable(&rb, NULL, stamps, 0));
+    assert(0 == ringbuf_init_growable(&grb, 4, sizeof(int), 0, NULL));
+    assert(-1 == ringbuf_latency_enable(&grb, &test_lat, stamps, 0));
+    ringbuf_free_growable(&grb);
+
+    // every element, through the single, bulk and zero-copy paths
+    assert(0 == ringbuf_latency_enable(&rb, &test_lat, stamps, 0));
+    assert(0 == ringbuf_latency_percentile_ns(&test_lat, 50));
+    for (int round = 0; round < 3; round++) {
+        assert(0 == ringbuf_add_tail(&rb, in));
+        assert(10 == ringbuf_add_tail_n(&rb, in, 10));
+        assert(ringbuf_reserve_tail(&rb) && 0 == ringbuf_commit_tail(&rb));
+        nanosleep(&ts, NULL);
+        assert(0 == ringbuf_remove_head(&rb, NULL));
+        assert(9 == ringbuf_remove_head_n(&rb, obuf, 9));
+        assert(ringbuf_peek_head_span(&rb, &n) && 0 == ringbuf_release_head_n(&rb, n));
+        assert(ringbuf_empty(&rb) || 0 == ringbuf_release_head_n(&rb, ringbuf_count(&rb)));
+    }
+    ringbuf_stats_snapshot(&rb, &st);
+    printf("lat samples=%zu p50=%lluns p99=%lluns max=%lluns\n", st.lat_samples,
+            (unsigned long long)st.lat_p50_ns, (unsigned long long)st.lat_p99_ns,
+            (unsigned long long)st.lat_max_ns);
+    assert(st.lat_samples == 36);
+    // within the clock calibration and the bucket resolution
+    assert(st.lat_p50_ns >= 1800000 && st.lat_p50_ns <= st.lat_p99_ns);
+    assert(st.lat_p99_ns <= st.lat_max_ns);
+    assert(ringbuf_latency_percentile_ns(&test_lat, 0) >= 1800000);
+    assert(ringbuf_latency_percentile_ns(&test_lat, 100) == st.lat_max_ns);
+
+    // bucket bounds are increasing and about 1/16 apart
+    for (size_t i = 16; i < 200; i++) {
+        assert(ringbuf_latency_bucket_ns(&test_lat, i) <= ringbuf_latency_bucket_ns(&test_lat, i + 1));
+    }
+
+    // 1 in 4 slots, with the contents wrapping
+    assert(0 == ringbuf_latency_enable(&rb, &test_lat, stamps, 2));
+    for (int round = 0; round < 10; round++) {
+        assert(LAT_BUF_LEN - 1 == ringbuf_add_tail_n(&rb, in, LAT_BUF_LEN - 1));
+        assert(LAT_BUF_LEN - 1 == ringbuf_remove_head_n(&rb, NULL, LAT_BUF_LEN - 1));
+        assert(0 == ringbuf_add_tail(&rb, in) && 0 == ringbuf_remove_head(&rb, NULL));
+    }
+    // slots 0, 4, 8 and 12 of 15: 4 per pass, and the single elements in slots 0..9
+    ringbuf_stats_snapshot(&rb, &st);
+    assert(st.lat_samples == 10 * 4 + 10 / 4 + 1);
+
+    // overwrite mode
+    assert(0 == ringbuf_init_flags(&rb, obuf, LAT_BUF_LEN, sizeof(int), RINGBUF_F_OVERWRITE));
+    assert(0 == ringbuf_latency_enable(&rb, &test_lat, stamps, 0));
+    assert(LAT_BUF_LEN == ringbuf_add_tail_n(&rb, in, LAT_BUF_LEN));
+    assert(4 == ringbuf_add_tail_n(&rb, in, 4)); // drops 4
+    assert(LAT_BUF_LEN == ringbuf_remove_head_n(&rb, NULL, LAT_BUF_LEN));
+    assert(LAT_BUF_LEN == atomic_load(&test_lat.samples));
+
+    ringbuf_latency_disable(&rb);
+    assert(0 == ringbuf_add_tail(&rb, in) && 0 == ringbuf_remove_head(&rb, NULL));
+    assert(LAT_BUF_LEN == atomic_load(&test_lat.samples));
+
+    // an overwrite claim snapshots at most 64 stamps, larger removes stop there
+    assert(0 == ringbuf_init_flags(&rb, lat_big, LAT_BIG_LEN, sizeof(int), RINGBUF_F_OVERWRITE));
+    assert(0 == ringbuf_latency_enable(&rb, &test_lat, lat_big_stamps, 0));
+    assert(LAT_BIG_LEN == ringbuf_add_tail_n(&rb, lat_big_in, LAT_BIG_LEN));
+    assert(64 == ringbuf_remove_head_n(&rb, NULL, LAT_BIG_LEN));
+    assert(64 == ringbuf_remove_head_n(&rb, NULL, LAT_BIG_LEN));
+    assert(LAT_BIG_LEN == atomic_load(&test_lat.samples));
+    ringbuf_latency_disable(&rb);
+#else
+    assert(-1 == ringbuf_latency_enable(&rb, &test_lat, stamps, 0));
+    (void)grb; (void)in; (void)obuf; (void)ts; (void)n;
+#endif
+    ringbuf_stats_snapshot(&rb, &st);
+    assert(0 == st.lat_samples || RINGBUF_TRACE);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
 int main(int argc, char** argv)
 {
     test_queue_char();
     test_queue_int();
     test_queue_my_struct();
     test_queue_my_struct_malloc();
+    test_queue_spsc_threads(ELEMS_BUF_LEN - 1); // odd capacity
+    test_queue_spsc_threads(ELEMS_BUF_LEN);
+    test_queue_pow2();
+    test_queue_bulk();
+    test_queue_zero_copy();
+    test_queue_scrub();
+    test_struct_layout();
+    test_queue_declared();
+    test_queue_wait();
+    test_queue_mirrored();
+    test_queue_overwrite();
+    test_queue_overwrite_threads();
+    test_queue_stats();
+    test_queue_large_elems();
+    test_queue_growable();
+    test_queue_range();
+    test_queue_latency();
 
     return 0;
 }
@@ -0,0 +1,269 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_window.c Sliding window aggregates over a ringbuf.
+ *
+ * The max deque holds the positions of the elements that can still become
+ * the maximum: each one is larger than every element added after it. A
+ * new element first drops the positions of all smaller ones from the back,
+ * and the head's position leaves from the front when the head is removed.
+ * The min deque is the same with the comparison reversed.
+ */
+#include <math.h>
+
+#include "ringbuf_window.h"
+
+// GCC/Clang vector extensions, compiled to SSE/AVX/NEON as available
+typedef double ringbuf_window_v4d __attribute__((vector_size(4 * sizeof(double))));
+
+static double ringbuf_window_val(const struct ringbuf_window *w, const void *p)
+{
+    switch (w->type) {
+    case RINGBUF_WINDOW_INT:
+        return *(const int *)p;
+    case RINGBUF_WINDOW_FLOAT:
+        return *(const float *)p;
+    default:
+        return *(const double *)p;
+    }
+}
+
+// value of the element at absolute position pos
+static double ringbuf_window_at(const struct ringbuf_window *w, size_t pos)
+{
+    return ringbuf_window_val(w, ringbuf_at(&w->rb, pos - w->base));
+}
+
+static inline size_t *ringbuf_window_q(const struct ringbuf_window *w, size_t *q, size_t front,
+        size_t i)
+{
+    size_t slot = front + i;
+
+    return &q[slot < w->rb.capacity ? slot : slot - w->rb.capacity];
+}
+
+// add pos (with value v) at the back of a deque, dropping the positions
+// it makes redundant. sign is 1 for the max deque, -1 for the min deque.
+static void ringbuf_window_q_push(struct ringbuf_window *w, size_t *q, size_t front,
+        size_t *len, size_t pos, double v, int sign)
+{
+    while (*len && sign * (ringbuf_window_at(w, *ringbuf_window_q(w, q, front, *len - 1)) - v) <= 0) {
+        (*len)--;
+    }
+    *ringbuf_window_q(w, q, front, (*len)++) = pos;
+}
+
+static void ringbuf_window_q_evict(struct ringbuf_window *w, size_t *q, size_t *front,
+        size_t *len, size_t pos)
+{
+    if (*len && q[*front] == pos) {
+        *front = *front + 1 < w->rb.capacity ? *front + 1 : 0;
+        (*len)--;
+    }
+}
+
+/**
+ * Initialize a ringbuf_window struct.
+ *
+ * Same external storage model as ringbuf_init: buf must hold n_elem
+ * elements of the given type. In addition, min_q and max_q must each point
+ * to an array of n_elem size_t. No memory allocation is performed.
+ *
+ * @param w pointer to the ringbuf_window struct to initialize
+ * @param buf pointer to the array buffer
+ * @param min_q pointer to the min deque array
+ * @param max_q pointer to the max deque array
+ * @param n_elem window size (maximum number of elements)
+ * @param type enum ringbuf_window_type of the elements
+ * @param flags RINGBUF_WINDOW_* flags
+ * @return 0 on success, -1 on invalid arguments
+ */
+int ringbuf_window_init(struct ringbuf_window *w, void *buf, size_t *min_q, size_t *max_q,
+        size_t n_elem, int type, unsigned flags)
+{
+    static const size_t elem_sz[] = { sizeof(int), sizeof(float), sizeof(double) };
+
+    if (!w || !min_q || !max_q || !n_elem || type < 0 || type > RINGBUF_WINDOW_DOUBLE) {
+        return -1;
+    }
+    if (ringbuf_init(&w->rb, buf, n_elem, elem_sz[type]) < 0) {
+        return -1;
+    }
+
+    w->type = type;
+    w->flags = flags;
+    w->base = 0;
+    w->isum = 0;
+    w->fsum = 0;
+    w->min_q = min_q;
+    w->max_q = max_q;
+    w->min_front = w->min_len = 0;
+    w->max_front = w->max_len = 0;
+
+    return 0;
+}
+
+/**
+ * Removes the oldest element from the window. O(1).
+ * @param elem where to copy the removed element. If NULL, the element is simply removed.
+ * @return 0 on success, -1 if the window is empty
+ */
+int ringbuf_window_remove_head(struct ringbuf_window *w, void *elem)
+{
+    const void *hp = ringbuf_at(&w->rb, 0);
+
+    if (!hp) {
+        return -1;
+    }
+    if (w->type == RINGBUF_WINDOW_INT) {
+        w->isum -= *(const int *)hp;
+    } else {
+        w->fsum -= ringbuf_window_val(w, hp);
+    }
+    ringbuf_window_q_evict(w, w->min_q, &w->min_front, &w->min_len, w->base);
+    ringbuf_window_q_evict(w, w->max_q, &w->max_front, &w->max_len, w->base);
+
+    ringbuf_remove_head(&w->rb, elem);
+    w->base++;
+    return 0;
+}
+
+/**
+ * Adds an element to the window. Amortized O(1).
+ * @param elem element to add. If NULL, the window is not modified and 0 is returned.
+ * @return 0 on success, -1 if the window is full (never with
+ * RINGBUF_WINDOW_OVERWRITE)
+ */
+int ringbuf_window_add_tail(struct ringbuf_window *w, const void *elem)
+{
+    size_t pos;
+    double v;
+
+    if (!elem) {
+        return 0;
+    }
+    if (ringbuf_full(&w->rb)) {
+        if (!(w->flags & RINGBUF_WINDOW_OVERWRITE)) {
+            return -1;
+        }
+        ringbuf_window_remove_head(w, NULL);
+    }
+
+    ringbuf_add_tail(&w->rb, elem);
+    pos = w->base + ringbuf_count(&w->rb) - 1;
+    v = ringbuf_window_val(w, elem);
+    if (w->type == RINGBUF_WINDOW_INT) {
+        w->isum += *(const int *)elem;
+    } else {
+        w->fsum += v;
+    }
+    ringbuf_window_q_push(w, w->min_q, w->min_front, &w->min_len, pos, v, -1);
+    ringbuf_window_q_push(w, w->max_q, w->max_front, &w->max_len, pos, v, 1);
+    return 0;
+}
+
+/**
+ * Returns the number of elements in the window.
+ */
+size_t ringbuf_window_count(const struct ringbuf_window *w)
+{
+    return ringbuf_count(&w->rb);
+}
+
+/**
+ * Returns the sum of the elements in the window, 0 if it is empty. O(1).
+ */
+double ringbuf_window_sum(const struct ringbuf_window *w)
+{
+    return w->type == RINGBUF_WINDOW_INT ? (double)w->isum : w->fsum;
+}
+
+/**
+ * Returns the mean of the elements in the window, NAN if it is empty. O(1).
+ */
+double ringbuf_window_mean(const struct ringbuf_window *w)
+{
+    size_t count = ringbuf_count(&w->rb);
+
+    return count ? ringbuf_window_sum(w) / count : NAN;
+}
+
+/**
+ * Returns the smallest element in the window, NAN if it is empty. O(1).
+ */
+double ringbuf_window_min(const struct ringbuf_window *w)
+{
+    return w->min_len ? ringbuf_window_at(w, w->min_q[w->min_front]) : NAN;
+}
+
+/**
+ * Returns the largest element in the window, NAN if it is empty. O(1).
+ */
+double ringbuf_window_max(const struct ringbuf_window *w)
+{
+    return w->max_len ? ringbuf_window_at(w, w->max_q[w->max_front]) : NAN;
+}
+
+// sum n doubles with four independent vector lanes
+static double ringbuf_window_sum_doubles(const double *p, size_t n)
+{
+    ringbuf_window_v4d acc = { 0, 0, 0, 0 }, v;
+    double sum;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __builtin_memcpy(&v, p + i, sizeof(v));
+        acc += v;
+    }
+    sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    for (; i < n; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+/**
+ * Recomputes all aggregates from the window contents. O(n).
+ *
+ * Resynchronizes the running float/double sum, which otherwise drifts by
+ * rounding error. The sum runs over the (at most two) contiguous spans of
+ * the ringbuf with vector instructions.
+ */
+void ringbuf_window_recompute(struct ringbuf_window *w)
+{
+    struct ringbuf_span spans[2];
+    size_t count = ringbuf_range(&w->rb, 0, w->rb.capacity, spans);
+
+    w->isum = 0;
+    w->fsum = 0;
+    for (int s = 0; s < 2; s++) {
+        size_t n = spans[s].n;
+
+        switch (w->type) {
+        case RINGBUF_WINDOW_INT:
+            for (size_t i = 0; i < n; i++) {
+                w->isum += ((const int *)spans[s].ptr)[i];
+            }
+            break;
+        case RINGBUF_WINDOW_FLOAT:
+            for (size_t i = 0; i < n; i++) {
+                w->fsum += ((const float *)spans[s].ptr)[i];
+            }
+            break;
+        default:
+            w->fsum += ringbuf_window_sum_doubles(spans[s].ptr, n);
+            break;
+        }
+    }
+
+    w->min_front = w->min_len = 0;
+    w->max_front = w->max_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        double v = ringbuf_window_at(w, w->base + i);
+
+        ringbuf_window_q_push(w, w->min_q, w->min_front, &w->min_len, w->base + i, v, -1);
+        ringbuf_window_q_push(w, w->max_q, w->max_front, &w->max_len, w->base + i, v, 1);
+    }
+}
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_WINDOW_H__
+#define __RINGBUF_WINDOW_H__
+
+/**
+ * @file ringbuf_window.h Sliding window over a ringbuf of numbers, with
+ * O(1) sum, mean, min and max.
+ */
+
+#include "ringbuf.h"
+
+/** Element types of a ringbuf_window */
+enum ringbuf_window_type {
+    RINGBUF_WINDOW_INT,
+    RINGBUF_WINDOW_FLOAT,
+    RINGBUF_WINDOW_DOUBLE,
+};
+
+/** ringbuf_window_init() flags */
+/** Adding to a full window evicts the oldest element instead of failing */
+#define RINGBUF_WINDOW_OVERWRITE (1u << 0)
+
+/**
+ * Sliding window aggregates over a ringbuf of int, float or double.
+ *
+ * Adding and removing elements keep a running sum, and two monotonic
+ * deques of element positions for the minimum and the maximum, so every
+ * aggregate query is O(1) and every update amortized O(1). The window
+ * owns its ringbuf: do not add or remove through rb directly. Not thread
+ * safe, use external locking to share one between threads.
+ *
+ * Running float/double sums accumulate rounding error over time; call
+ * ringbuf_window_recompute now and then to resynchronize.
+ */
+struct ringbuf_window {
+    /** Element storage, read it in place with ringbuf_at/ringbuf_range */
+    struct ringbuf rb;
+    /** enum ringbuf_window_type */
+    int type;
+    /** RINGBUF_WINDOW_* flags */
+    unsigned flags;
+    /** Total number of elements removed, the position of the head element */
+    size_t base;
+    /** Running sum, for RINGBUF_WINDOW_INT */
+    long long isum;
+    /** Running sum, for RINGBUF_WINDOW_FLOAT/RINGBUF_WINDOW_DOUBLE */
+    double fsum;
+    /**
+     * Deques of element positions (capacity entries each, used as rings)
+     * with increasing (min) or decreasing (max) values. Their fronts are the
+     * positions of the minimum and maximum.
+     */
+    size_t *min_q, *max_q;
+    /** Front index and length of min_q and max_q */
+    size_t min_front, min_len, max_front, max_len;
+};
+
+int ringbuf_window_init(struct ringbuf_window *w, void *buf, size_t *min_q, size_t *max_q,
+        size_t n_elem, int type, unsigned flags);
+int ringbuf_window_add_tail(struct ringbuf_window *w, const void *elem);
+int ringbuf_window_remove_head(struct ringbuf_window *w, void *elem);
+size_t ringbuf_window_count(const struct ringbuf_window *w);
+double ringbuf_window_sum(const struct ringbuf_window *w);
+double ringbuf_window_mean(const struct ringbuf_window *w);
+double ringbuf_window_min(const struct ringbuf_window *w);
+double ringbuf_window_max(const struct ringbuf_window *w);
+void ringbuf_window_recompute(struct ringbuf_window *w);
+
+#endif
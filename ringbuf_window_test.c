@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_window_test.c Example usage for sliding window aggregates.
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ringbuf_window.h"
+
+#define WINDOW_LEN 7
+
+// deterministic, widely ranged test values
+static double test_val(int i)
+{
+    return (double)((i * 2654435761u) % 2000001) - 1e6 + 0.1;
+}
+
+// compare against a brute force scan of the window
+static void check_window(const struct ringbuf_window *w, const int *vals, size_t first,
+        size_t n)
+{
+    long long sum = 0;
+    int min = vals[first], max = vals[first];
+
+    assert(ringbuf_window_count(w) == n);
+    for (size_t i = first; i < first + n; i++) {
+        sum += vals[i];
+        min = vals[i] < min ? vals[i] : min;
+        max = vals[i] > max ? vals[i] : max;
+    }
+    assert(ringbuf_window_sum(w) == (double)sum);
+    assert(ringbuf_window_min(w) == min && ringbuf_window_max(w) == max);
+    assert(fabs(ringbuf_window_mean(w) - (double)sum / n) < 1e-9);
+}
+
+static void test_window_int(void)
+{
+    int buf[WINDOW_LEN], vals[1000], x;
+    size_t min_q[WINDOW_LEN], max_q[WINDOW_LEN];
+    struct ringbuf_window w;
+    size_t first = 0;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    srand(1);
+    for (int i = 0; i < 1000; i++) {
+        vals[i] = rand() % 200 - 100;
+    }
+
+    assert(-1 == ringbuf_window_init(&w, buf, min_q, max_q, WINDOW_LEN, 7, 0));
+    assert(0 == ringbuf_window_init(&w, buf, min_q, max_q, WINDOW_LEN, RINGBUF_WINDOW_INT, 0));
+    assert(isnan(ringbuf_window_min(&w)) && isnan(ringbuf_window_mean(&w)));
+    assert(0 == ringbuf_window_sum(&w));
+
+    for (int i = 0; i < WINDOW_LEN; i++) {
+        assert(0 == ringbuf_window_add_tail(&w, &vals[i]));
+        check_window(&w, vals, 0, i + 1);
+    }
+    assert(-1 == ringbuf_window_add_tail(&w, &vals[0])); // full
+
+    // slide with uneven steps, shrinking and growing the window
+    for (size_t next = WINDOW_LEN; next < 1000; next++) {
+        if (rand() % 3 == 0 && ringbuf_window_count(&w) > 1) {
+            assert(0 == ringbuf_window_remove_head(&w, &x) && x == vals[first]);
+            first++;
+        }
+        if (ringbuf_window_count(&w) == WINDOW_LEN) {
+            assert(0 == ringbuf_window_remove_head(&w, NULL));
+            first++;
+        }
+        assert(0 == ringbuf_window_add_tail(&w, &vals[next]));
+        check_window(&w, vals, first, next + 1 - first);
+    }
+
+    while (0 == ringbuf_window_remove_head(&w, NULL)) {
+    }
+    assert(0 == ringbuf_window_sum(&w) && isnan(ringbuf_window_max(&w)));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static void test_window_double_overwrite(void)
+{
+    double buf[WINDOW_LEN], x, sum, min, max;
+    size_t min_q[WINDOW_LEN], max_q[WINDOW_LEN];
+    struct ringbuf_window w;
+    float fbuf[WINDOW_LEN], f;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_window_init(&w, buf, min_q, max_q, WINDOW_LEN, RINGBUF_WINDOW_DOUBLE,
+                RINGBUF_WINDOW_OVERWRITE));
+    for (int i = 0; i < 100000; i++) {
+        x = test_val(i);
+        assert(0 == ringbuf_window_add_tail(&w, &x));
+    }
+    assert(WINDOW_LEN == ringbuf_window_count(&w));
+
+    sum = 0;
+    min = INFINITY;
+    max = -INFINITY;
+    for (int i = 100000 - WINDOW_LEN; i < 100000; i++) {
+        x = test_val(i);
+        sum += x;
+        min = x < min ? x : min;
+        max = x > max ? x : max;
+    }
+    assert(ringbuf_window_min(&w) == min && ringbuf_window_max(&w) == max);
+    printf("running sum drift: %g\n", ringbuf_window_sum(&w) - sum);
+    assert(fabs(ringbuf_window_sum(&w) - sum) < 1e-3);
+
+    // recompute resynchronizes the sum and rebuilds min/max
+    ringbuf_window_recompute(&w);
+    assert(fabs(ringbuf_window_sum(&w) - sum) < 1e-6);
+    assert(ringbuf_window_min(&w) == min && ringbuf_window_max(&w) == max);
+
+    assert(0 == ringbuf_window_init(&w, fbuf, min_q, max_q, WINDOW_LEN, RINGBUF_WINDOW_FLOAT,
+                RINGBUF_WINDOW_OVERWRITE));
+    for (int i = 0; i < 20; i++) {
+        f = i % 5;
+        assert(0 == ringbuf_window_add_tail(&w, &f));
+    }
+    // 13..19 -> 3 4 0 1 2 3 4
+    assert(ringbuf_window_sum(&w) == 17 && ringbuf_window_min(&w) == 0 && ringbuf_window_max(&w) == 4);
+    ringbuf_window_recompute(&w);
+    assert(ringbuf_window_sum(&w) == 17 && ringbuf_window_min(&w) == 0 && ringbuf_window_max(&w) == 4);
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_window_int();
+    test_window_double_overwrite();
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_ws.c Sharded work-stealing task queue.
+ *
+ * Positions run freely and are masked on access, as with RINGBUF_F_POW2;
+ * a deque holds bottom - top elements. The owner's pop and a thief's steal
+ * race only for the last element, and settle it with a CAS on top after a
+ * seq_cst fence on both sides (Le et al., "Correct and Efficient
+ * Work-Stealing for Weak Memory Models").
+ *
+ * Stealing half moves elements one CAS at a time. A single CAS over a
+ * whole batch would be unsafe: between reading bottom and the CAS the
+ * owner may pop into the batch without seeing the thief.
+ *
+ * A thief that stalls between reading bottom and its CAS may copy a slot
+ * the owner has since wrapped around to and is rewriting; the CAS then
+ * fails and the copy is discarded. Slots are therefore only accessed with
+ * relaxed atomics, so that torn read is not a data race.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ringbuf_ws.h"
+
+static inline void *ringbuf_ws_slot(const struct ringbuf_ws *ws, const struct ringbuf_ws_deque *d,
+        size_t pos)
+{
+    return (char *)d->buf + ws->elem_sz * (pos & ws->mask);
+}
+
+// copy n bytes with relaxed atomic accesses, a word at a time when both
+// sides are word aligned and n is a multiple of the word size
+static void ringbuf_ws_copy(void *dst, const void *src, size_t n)
+{
+    if (!(((uintptr_t)dst | (uintptr_t)src | n) % sizeof(size_t))) {
+        _Atomic size_t *d = dst;
+        const _Atomic size_t *s = src;
+
+        for (size_t i = 0; i < n / sizeof(size_t); i++) {
+            atomic_store_explicit(&d[i], atomic_load_explicit(&s[i], memory_order_relaxed),
+                    memory_order_relaxed);
+        }
+    } else {
+        _Atomic unsigned char *d = dst;
+        const _Atomic unsigned char *s = src;
+
+        for (size_t i = 0; i < n; i++) {
+            atomic_store_explicit(&d[i], atomic_load_explicit(&s[i], memory_order_relaxed),
+                    memory_order_relaxed);
+        }
+    }
+}
+
+// steal the top element of victim into slot dst
+// @return 1 on success, 0 if victim is empty, -1 if another worker won the race
+static int ringbuf_ws_steal_one(struct ringbuf_ws *ws, struct ringbuf_ws_deque *v, void *dst,
+        size_t *left)
+{
+    size_t t = atomic_load_explicit(&v->top, memory_order_acquire);
+    size_t b;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    b = atomic_load_explicit(&v->bottom, memory_order_acquire);
+    if ((ptrdiff_t)(b - t) <= 0) {
+        return 0;
+    }
+    *left = b - t;
+    // only valid if the CAS below succeeds, see the file comment
+    ringbuf_ws_copy(dst, ringbuf_ws_slot(ws, v, t), ws->elem_sz);
+    if (!atomic_compare_exchange_strong_explicit(&v->top, &t, t + 1, memory_order_seq_cst,
+                memory_order_relaxed)) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * Initialize a ringbuf_ws struct.
+ *
+ * Same external storage model as ringbuf_init: buf must hold
+ * n_deques * n_elem elements of elem_sz bytes (deque w uses the w-th
+ * block of n_elem), and deques must point to n_deques deque structs. No
+ * memory allocation is performed.
+ *
+ * @param ws pointer to the ringbuf_ws struct to initialize
+ * @param buf pointer to the array buffer
+ * @param deques pointer to the deque state array
+ * @param n_deques number of deques (workers)
+ * @param n_elem maximum number of elements per deque, must be a power of two
+ * @param elem_sz the size (bytes) of each element
+ * @return 0 on success, -1 on invalid arguments
+ */
+int ringbuf_ws_init(struct ringbuf_ws *ws, void *buf, struct ringbuf_ws_deque *deques,
+        size_t n_deques, size_t n_elem, size_t elem_sz)
+{
+    if (!ws || !buf || !deques || !n_deques) {
+        return -1;
+    }
+    if (!n_elem || (n_elem & (n_elem - 1))) {
+        return -1;
+    }
+
+    ws->deques = deques;
+    ws->n_deques = n_deques;
+    ws->capacity = n_elem;
+    ws->mask = n_elem - 1;
+    ws->elem_sz = elem_sz;
+    for (size_t i = 0; i < n_deques; i++) {
+        deques[i].buf = (char *)buf + i * n_elem * elem_sz;
+        atomic_init(&deques[i].top, 0);
+        atomic_init(&deques[i].bottom, 0);
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the number of elements in the deque of worker (a snapshot).
+ */
+size_t ringbuf_ws_count(const struct ringbuf_ws *ws, size_t worker)
+{
+    const struct ringbuf_ws_deque *d = &ws->deques[worker];
+    size_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    size_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    return (ptrdiff_t)(b - t) > 0 ? b - t : 0;
+}
+
+/**
+ * Adds an element to the owner's end of worker's deque. Owner side.
+ * @param elem element to add. If NULL, the deque is not modified and 0 is returned.
+ * @return 0 on success, -1 if the deque is full
+ */
+int ringbuf_ws_push(struct ringbuf_ws *ws, size_t worker, const void *elem)
+{
+    struct ringbuf_ws_deque *d = &ws->deques[worker];
+    size_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    size_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+
+    if (!elem) {
+        return 0;
+    }
+    if (b - t >= ws->capacity) {
+        return -1;
+    }
+    ringbuf_ws_copy(ringbuf_ws_slot(ws, d, b), elem, ws->elem_sz);
+    // release: the element is written before thieves can see it
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Removes the most recently pushed element of worker's deque. Owner side.
+ * @param elem where to copy the removed element. If NULL, the element is simply removed.
+ * @return 0 on success, -1 if the deque is empty
+ */
+int ringbuf_ws_pop(struct ringbuf_ws *ws, size_t worker, void *elem)
+{
+    struct ringbuf_ws_deque *d = &ws->deques[worker];
+    size_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    size_t t;
+    int ret = 0;
+
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if ((ptrdiff_t)(b - t) < 0) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return -1;
+    }
+    if (b == t) {
+        // last element: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                    memory_order_relaxed)) {
+            ret = -1;
+        }
+    }
+    if (ret == 0 && elem) {
+        ringbuf_ws_copy(elem, ringbuf_ws_slot(ws, d, b), ws->elem_sz);
+    }
+    if (b == t) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return ret;
+}
+
+/**
+ * Steals half (at least one) of victim's elements into worker's own deque,
+ * oldest first. Only the owner of worker may call this.
+ * @return number of elements moved, 0 if victim was empty or worker's deque is full
+ */
+size_t ringbuf_ws_steal(struct ringbuf_ws *ws, size_t worker, size_t victim)
+{
+    struct ringbuf_ws_deque *d = &ws->deques[worker];
+    struct ringbuf_ws_deque *v = &ws->deques[victim];
+    size_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    size_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    size_t moved = 0, want = 1, left;
+    int ret;
+
+    if (worker == victim) {
+        return 0;
+    }
+    while (moved < want && b - t < ws->capacity) {
+        ret = ringbuf_ws_steal_one(ws, v, ringbuf_ws_slot(ws, d, b), &left);
+        if (ret == 0) {
+            break;
+        }
+        if (ret < 0) {
+            continue;
+        }
+        if (!moved) {
+            want = (left + 1) / 2;
+        }
+        moved++;
+        b++;
+        atomic_store_explicit(&d->bottom, b, memory_order_release);
+    }
+    return moved;
+}
+
+/**
+ * Takes a task for worker: pops its own deque, or else steals half of the
+ * first non-empty other deque (scanning from worker + 1) and pops from
+ * that. Owner side.
+ * @param elem where to copy the element. If NULL, the element is simply removed.
+ * @return 0 on success, -1 if all deques were found empty
+ */
+int ringbuf_ws_take(struct ringbuf_ws *ws, size_t worker, void *elem)
+{
+    if (ringbuf_ws_pop(ws, worker, elem) == 0) {
+        return 0;
+    }
+    for (size_t i = 1; i < ws->n_deques; i++) {
+        size_t victim = (worker + i) % ws->n_deques;
+
+        if (ringbuf_ws_steal(ws, worker, victim) && ringbuf_ws_pop(ws, worker, elem) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_WS_H__
+#define __RINGBUF_WS_H__
+
+/**
+ * @file ringbuf_ws.h Sharded task queue: one work-stealing deque per
+ * worker thread.
+ */
+
+#include "ringbuf.h"
+
+/**
+ * One worker's deque (Chase-Lev). The owner pushes and pops at bottom,
+ * other workers steal at top.
+ */
+struct ringbuf_ws_deque {
+    /** Base pointer of this deque's element array */
+    void *buf;
+    /** Next position to steal. Advanced by thieves (and the owner) with CAS. */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t top;
+    /** Next position the owner pushes. Written only by the owner. */
+    _Alignas(RINGBUF_CACHELINE) atomic_size_t bottom;
+};
+
+/**
+ * Sharded work-stealing task queue over n_deques per-worker deques.
+ *
+ * Worker w pushes and pops its own deque (LIFO) with plain loads and
+ * stores; only popping the very last element needs a CAS. When it runs
+ * dry, ringbuf_ws_take steals half of another worker's deque (FIFO) into
+ * its own, so dispatch stays local and workers only ever contend on the
+ * top index of a victim. Elements are elem_sz bytes, copied with relaxed
+ * atomic accesses since a thief may read a slot the owner is rewriting:
+ * a word at a time if elem_sz is a multiple of sizeof(size_t) and buf and
+ * the caller's element are word aligned, else a byte at a time. Keep
+ * elements small, e.g. a task pointer or index.
+ */
+struct ringbuf_ws {
+    /** Deques, one per worker */
+    struct ringbuf_ws_deque *deques;
+    /** Number of deques (workers) */
+    size_t n_deques;
+    /** Maximum number of elements in each deque, a power of two */
+    size_t capacity;
+    /** capacity - 1 */
+    size_t mask;
+    /** Size of each element (bytes) */
+    size_t elem_sz;
+};
+
+int ringbuf_ws_init(struct ringbuf_ws *ws, void *buf, struct ringbuf_ws_deque *deques,
+        size_t n_deques, size_t n_elem, size_t elem_sz);
+size_t ringbuf_ws_count(const struct ringbuf_ws *ws, size_t worker);
+int ringbuf_ws_push(struct ringbuf_ws *ws, size_t worker, const void *elem);
+int ringbuf_ws_pop(struct ringbuf_ws *ws, size_t worker, void *elem);
+size_t ringbuf_ws_steal(struct ringbuf_ws *ws, size_t worker, size_t victim);
+int ringbuf_ws_take(struct ringbuf_ws *ws, size_t worker, void *elem);
+
+#endif
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_ws_test.c Example usage for the work-stealing task queue.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "ringbuf_ws.h"
+
+#define ELEMS_BUF_LEN 16
+#define N_WORKERS 4
+#define N_ITEMS 100000
+
+struct task {
+    int id;
+    int arg;
+};
+
+static void test_ws_basic(void)
+{
+    struct task buf[2 * ELEMS_BUF_LEN], t;
+    struct ringbuf_ws_deque deques[2];
+    struct ringbuf_ws ws;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(-1 == ringbuf_ws_init(&ws, buf, deques, 0, ELEMS_BUF_LEN, sizeof(t)));
+    assert(-1 == ringbuf_ws_init(&ws, buf, deques, 2, ELEMS_BUF_LEN - 1, sizeof(t)));
+    assert(0 == ringbuf_ws_init(&ws, buf, deques, 2, ELEMS_BUF_LEN, sizeof(t)));
+    assert(-1 == ringbuf_ws_pop(&ws, 0, &t));
+    assert(-1 == ringbuf_ws_take(&ws, 1, &t));
+
+    for (int i = 0; i < ELEMS_BUF_LEN; i++) {
+        t.id = i;
+        assert(0 == ringbuf_ws_push(&ws, 0, &t));
+    }
+    assert(-1 == ringbuf_ws_push(&ws, 0, &t));
+    assert(ELEMS_BUF_LEN == ringbuf_ws_count(&ws, 0));
+
+    // owner pops LIFO
+    assert(0 == ringbuf_ws_pop(&ws, 0, &t) && t.id == ELEMS_BUF_LEN - 1);
+
+    // thief takes the older half, oldest first, and pops the newest of those
+    assert(0 == ringbuf_ws_steal(&ws, 0, 0));
+    assert(8 == ringbuf_ws_steal(&ws, 1, 0));
+    assert(7 == ringbuf_ws_count(&ws, 0) && 8 == ringbuf_ws_count(&ws, 1));
+    assert(0 == ringbuf_ws_pop(&ws, 1, &t) && t.id == 7);
+    assert(0 == ringbuf_ws_take(&ws, 1, &t) && t.id == 6);
+
+    // drain worker 0 down to one element, then the last element race
+    for (int i = ELEMS_BUF_LEN - 2; i > 8; i--) {
+        assert(0 == ringbuf_ws_pop(&ws, 0, &t) && t.id == i);
+    }
+    assert(1 == ringbuf_ws_steal(&ws, 1, 0));
+    assert(-1 == ringbuf_ws_pop(&ws, 0, &t));
+    assert(0 == ringbuf_ws_count(&ws, 0));
+    t.id = 100;
+    assert(0 == ringbuf_ws_push(&ws, 0, &t));
+    assert(0 == ringbuf_ws_pop(&ws, 0, &t) && t.id == 100);
+    assert(-1 == ringbuf_ws_pop(&ws, 0, &t));
+
+    // worker 0 takes back 0 1 2 3 of worker 1's 0 1 2 3 4 5 8
+    assert(0 == ringbuf_ws_take(&ws, 0, &t) && t.id == 3);
+    assert(3 == ringbuf_ws_count(&ws, 0) && 3 == ringbuf_ws_count(&ws, 1));
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+static struct ringbuf_ws ws_rb;
+static atomic_int ws_seen[N_ITEMS];
+static atomic_int ws_done;
+
+// worker 0 generates all tasks; everyone (worker 0 included) runs them
+static void *ws_worker(void *arg)
+{
+    size_t self = (size_t)arg;
+    struct task t;
+    int next = 0;
+
+    while (atomic_load(&ws_done) < N_ITEMS) {
+        if (self == 0 && next < N_ITEMS) {
+            t.id = next;
+            t.arg = next * 3;
+            if (0 == ringbuf_ws_push(&ws_rb, 0, &t)) {
+                next++;
+                continue;
+            }
+        }
+        if (0 == ringbuf_ws_take(&ws_rb, self, &t)) {
+            assert(t.arg == t.id * 3);
+            assert(0 == atomic_fetch_add(&ws_seen[t.id], 1));
+            atomic_fetch_add(&ws_done, 1);
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_ws_threads(void)
+{
+    static struct task buf[N_WORKERS * ELEMS_BUF_LEN];
+    struct ringbuf_ws_deque deques[N_WORKERS];
+    pthread_t threads[N_WORKERS];
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(0 == ringbuf_ws_init(&ws_rb, buf, deques, N_WORKERS, ELEMS_BUF_LEN, sizeof(buf[0])));
+    for (size_t i = 0; i < N_WORKERS; i++) {
+        assert(0 == pthread_create(&threads[i], NULL, ws_worker, (void *)i));
+    }
+    for (size_t i = 0; i < N_WORKERS; i++) {
+        assert(0 == pthread_join(threads[i], NULL));
+    }
+    for (int i = 0; i < N_ITEMS; i++) {
+        assert(1 == ws_seen[i]);
+    }
+
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_ws_basic();
+    test_ws_threads();
+
+    return 0;
+}
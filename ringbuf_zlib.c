@@ -0,0 +1,179 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+/**
+ * @file ringbuf_zlib.c zlib compression of ringbuf contents in place.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include "ringbuf_zlib.h"
+
+// zlib counts in uInt, so larger spans are fed in pieces
+#define RINGBUF_ZLIB_CHUNK ((size_t)UINT_MAX)
+
+/**
+ * Initializes z for compressing with ringbuf_drain_deflate.
+ * @param level zlib compression level, Z_DEFAULT_COMPRESSION or 0..9
+ * @return 0 on success, -1 on failure
+ */
+int ringbuf_zlib_deflate_init(struct ringbuf_zlib *z, int level)
+{
+    memset(z, 0, sizeof(*z));
+    z->deflate = 1;
+    return deflateInit(&z->zs, level) == Z_OK ? 0 : -1;
+}
+
+/**
+ * Initializes z for decompressing with ringbuf_fill_inflate.
+ * @return 0 on success, -1 on failure
+ */
+int ringbuf_zlib_inflate_init(struct ringbuf_zlib *z)
+{
+    memset(z, 0, sizeof(*z));
+    return inflateInit(&z->zs) == Z_OK ? 0 : -1;
+}
+
+/**
+ * Frees the zlib state of z.
+ */
+void ringbuf_zlib_end(struct ringbuf_zlib *z)
+{
+    if (z->deflate) {
+        deflateEnd(&z->zs);
+    } else {
+        inflateEnd(&z->zs);
+    }
+}
+
+/**
+ * Compresses stored elements straight out of the ringbuf into out, and
+ * releases the elements deflate consumed. Consumer side.
+ *
+ * Call until the ringbuf is empty; with finish set, the stream is then
+ * ended (z->done) once out has room for the trailer.
+ * @param out compressed output buffer
+ * @param out_sz size of out (bytes)
+ * @param finish nonzero to end the stream once all stored elements are consumed
+ * @return number of compressed bytes written to out, -1 on error (errno set,
+ * ESTALE if RINGBUF_F_OVERWRITE overwrote elements being compressed)
+ */
+ssize_t ringbuf_drain_deflate(struct ringbuf *rb, struct ringbuf_zlib *z, void *out,
+        size_t out_sz, int finish)
+{
+    struct ringbuf_span spans[2];
+    size_t n, total, skip = z->partial;
+    int ret;
+
+    if (z->done) {
+        return 0;
+    }
+    n = ringbuf_head_spans(rb, spans);
+    z->zs.next_out = out;
+    z->zs.avail_out = out_sz < RINGBUF_ZLIB_CHUNK ? out_sz : RINGBUF_ZLIB_CHUNK;
+    total = skip;
+
+    for (int s = 0; s < 2 && z->zs.avail_out; s++) {
+        char *p = (char *)spans[s].ptr + skip;
+        size_t left = spans[s].n * rb->elem_sz - skip;
+
+        skip = 0;
+        while (left && z->zs.avail_out) {
+            size_t in = left < RINGBUF_ZLIB_CHUNK ? left : RINGBUF_ZLIB_CHUNK;
+
+            z->zs.next_in = (Bytef *)p;
+            z->zs.avail_in = in;
+            deflate(&z->zs, Z_NO_FLUSH);
+            in -= z->zs.avail_in;
+            p += in;
+            left -= in;
+            total += in;
+        }
+    }
+
+    if (finish && total == n * rb->elem_sz && z->zs.avail_out) {
+        z->zs.avail_in = 0;
+        ret = deflate(&z->zs, Z_FINISH);
+        if (ret == Z_STREAM_END) {
+            z->done = 1;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    z->partial = total % rb->elem_sz;
+    if (total / rb->elem_sz && ringbuf_release_head_n(rb, total / rb->elem_sz) < 0) {
+        errno = ESTALE;
+        return -1;
+    }
+    return (char *)z->zs.next_out - (char *)out;
+}
+
+/**
+ * Decompresses from in straight into the free space of the ringbuf, and
+ * publishes the complete elements produced. Producer side.
+ *
+ * Call again with the rest of the input (in + the returned count) when the
+ * ringbuf has room, until z->done.
+ * @param in compressed input
+ * @param in_sz size of in (bytes)
+ * @return number of compressed bytes consumed from in, -1 on error (errno
+ * set, ENOBUFS if the ringbuf is full, EILSEQ if the input is corrupt)
+ */
+ssize_t ringbuf_fill_inflate(struct ringbuf *rb, struct ringbuf_zlib *z, const void *in,
+        size_t in_sz)
+{
+    struct ringbuf_span spans[2];
+    size_t total, skip = z->partial;
+    int ret = Z_OK;
+
+    if (z->done) {
+        return 0;
+    }
+    if (!ringbuf_tail_spans(rb, spans)) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    z->zs.next_in = (Bytef *)in;
+    z->zs.avail_in = in_sz < RINGBUF_ZLIB_CHUNK ? in_sz : RINGBUF_ZLIB_CHUNK;
+    total = skip;
+
+    for (int s = 0; s < 2 && ret == Z_OK; s++) {
+        char *p = (char *)spans[s].ptr + skip;
+        size_t left = spans[s].n * rb->elem_sz - skip;
+
+        skip = 0;
+        while (left && ret == Z_OK) {
+            size_t out = left < RINGBUF_ZLIB_CHUNK ? left : RINGBUF_ZLIB_CHUNK;
+
+            z->zs.next_out = (Bytef *)p;
+            z->zs.avail_out = out;
+            ret = inflate(&z->zs, Z_NO_FLUSH);
+            out -= z->zs.avail_out;
+            p += out;
+            left -= out;
+            total += out;
+            if (z->zs.avail_out) {
+                // input exhausted or end of stream
+                break;
+            }
+        }
+        if (z->zs.avail_out) {
+            break;
+        }
+    }
+
+    if (ret == Z_STREAM_END) {
+        z->done = 1;
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        errno = EILSEQ;
+        return -1;
+    }
+
+    z->partial = total % rb->elem_sz;
+    ringbuf_commit_tail_n(rb, total / rb->elem_sz);
+    return (const char *)z->zs.next_in - (const char *)in;
+}
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __RINGBUF_ZLIB_H__
+#define __RINGBUF_ZLIB_H__
+
+/**
+ * @file ringbuf_zlib.h Compressing the contents of a ringbuf straight out
+ * of its storage, and decompressing straight into it, with zlib.
+ *
+ * ringbuf_drain_deflate feeds the stored head spans to deflate in place and
+ * releases what was consumed; ringbuf_fill_inflate inflates into the free
+ * tail spans and publishes what was produced. There are no intermediate
+ * buffers besides the caller's compressed data. Elements of any size are
+ * supported: an element split between two calls stays in the ringbuf
+ * (unreleased or unpublished) until it is complete.
+ *
+ * Built only when zlib is available (RINGBUF_ZLIB in the Makefile).
+ */
+
+#include <sys/types.h>
+#include <zlib.h>
+
+#include "ringbuf.h"
+
+/**
+ * Compression or decompression state for one stream.
+ */
+struct ringbuf_zlib {
+    /** zlib stream state */
+    z_stream zs;
+    /** Bytes of the head (deflate) or tail (inflate) element already processed */
+    size_t partial;
+    /** Set once the end of the stream was written (deflate) or read (inflate) */
+    int done;
+    /** Nonzero for a deflate stream, 0 for an inflate stream */
+    int deflate;
+};
+
+int ringbuf_zlib_deflate_init(struct ringbuf_zlib *z, int level);
+int ringbuf_zlib_inflate_init(struct ringbuf_zlib *z);
+void ringbuf_zlib_end(struct ringbuf_zlib *z);
+ssize_t ringbuf_drain_deflate(struct ringbuf *rb, struct ringbuf_zlib *z, void *out,
+        size_t out_sz, int finish);
+ssize_t ringbuf_fill_inflate(struct ringbuf *rb, struct ringbuf_zlib *z, const void *in,
+        size_t in_sz);
+
+#endif
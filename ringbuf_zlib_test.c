@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: 0BSD */
+/*
+ * Copyright (C) 2023, by Scott Zuk <zooknotic@proton.me>
+ */
+
+/**
+ * @file ringbuf_zlib_test.c Example usage for compressing ringbuf contents.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ringbuf_zlib.h"
+
+#define ELEMS_BUF_LEN 50
+#define N_ITEMS 10000
+
+struct sample {
+    int seq;
+    short delta[4];
+};
+
+static void make_sample(struct sample *s, int i)
+{
+    memset(s, 0, sizeof(*s));
+    s->seq = i;
+    s->delta[i % 4] = i % 7 - 3;
+}
+
+static void test_zlib_roundtrip(void)
+{
+    struct sample buf[ELEMS_BUF_LEN], out_buf[ELEMS_BUF_LEN], s, expect;
+    size_t comp_sz = 0, comp_max = N_ITEMS * sizeof(s), off = 0;
+    unsigned char *comp = malloc(comp_max);
+    struct ringbuf rb, out_rb;
+    struct ringbuf_zlib z;
+    int produced = 0, consumed = 0;
+    ssize_t n;
+
+    printf("==== %s START ====\n", __FUNCTION__);
+
+    assert(comp);
+    assert(0 == ringbuf_init(&rb, buf, ELEMS_BUF_LEN, sizeof(s)));
+    assert(0 == ringbuf_zlib_deflate_init(&z, Z_DEFAULT_COMPRESSION));
+
+    // tiny output chunks split elements between calls
+    while (!z.done) {
+        while (produced < N_ITEMS && !ringbuf_full(&rb)) {
+            make_sample(&s, produced++);
+            assert(0 == ringbuf_add_tail(&rb, &s));
+        }
+        n = ringbuf_drain_deflate(&rb, &z, comp + comp_sz, 7, produced == N_ITEMS);
+        assert(n >= 0);
+        comp_sz += n;
+        assert(comp_sz <= comp_max);
+    }
+    ringbuf_zlib_end(&z);
+    assert(produced == N_ITEMS && ringbuf_empty(&rb));
+    assert(0 == ringbuf_drain_deflate(&rb, &z, comp, 1, 1)); // done
+    printf("compressed %zu -> %zu bytes\n", N_ITEMS * sizeof(s), comp_sz);
+    assert(comp_sz < N_ITEMS * sizeof(s) / 4);
+
+    assert(0 == ringbuf_init(&out_rb, out_buf, ELEMS_BUF_LEN, sizeof(s)));
+    assert(0 == ringbuf_zlib_inflate_init(&z));
+    while (!z.done) {
+        n = ringbuf_fill_inflate(&out_rb, &z, comp + off, comp_sz - off < 5 ? comp_sz - off : 5);
+        if (n < 0) {
+            assert(errno == ENOBUFS);
+        } else {
+            off += n;
+        }
+        // drain only part of the ringbuf, so it is full now and then
+        for (int i = 0; i < 3 && 0 == ringbuf_remove_head(&out_rb, &s); i++) {
+            make_sample(&expect, consumed++);
+            assert(0 == memcmp(&s, &expect, sizeof(s)));
+        }
+    }
+    while (0 == ringbuf_remove_head(&out_rb, &s)) {
+        make_sample(&expect, consumed++);
+        assert(0 == memcmp(&s, &expect, sizeof(s)));
+    }
+    assert(consumed == N_ITEMS && off == comp_sz);
+    ringbuf_zlib_end(&z);
+
+    // corrupt input
+    assert(0 == ringbuf_zlib_inflate_init(&z));
+    memset(comp, 0xff, 16);
+    assert(-1 == ringbuf_fill_inflate(&out_rb, &z, comp, 16) && errno == EILSEQ);
+    ringbuf_zlib_end(&z);
+
+    free(comp);
+    printf("==== %s END ====\n", __FUNCTION__);
+}
+
+int main(int argc, char** argv)
+{
+    test_zlib_roundtrip();
+
+    return 0;
+}